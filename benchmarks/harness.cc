@@ -0,0 +1,384 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Runs suites of solver benchmarks, writes the results as JSON, and compares
+// them against a baseline (eg. benchmarks/baseline.json) written previously by
+// this same harness.  Returns 2 if any case regressed beyond the thresholds.
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "../src/converter.h"
+#include "../src/generator.h"
+#include "../src/minimalloc.h"
+#include "../src/solver.h"
+
+ABSL_FLAG(std::string, suites, "challenging",
+          "The suites to run ('challenging', 'synthetic' and/or 'ablation').");
+ABSL_FLAG(std::string, filter, "",
+          "Only runs cases whose names contain this substring.");
+ABSL_FLAG(int, repetitions, 3, "The number of times each case is run.");
+ABSL_FLAG(absl::Duration, timeout, absl::Seconds(60),
+          "The time limit enforced for each run.");
+ABSL_FLAG(std::string, challenging_dir, MINIMALLOC_BENCHMARKS_DIR
+          "/challenging", "The directory of the challenging suite.");
+ABSL_FLAG(int64_t, capacity, 1048576,
+          "The capacity used for the challenging & ablation suites.");
+ABSL_FLAG(std::string, synthetic_scales, "1000,10000,100000",
+          "The buffer counts of the synthetic suite.");
+ABSL_FLAG(std::string, output, "", "The path to the JSON results file.");
+ABSL_FLAG(std::string, baseline, "", "The path to a JSON baseline file.");
+ABSL_FLAG(double, threshold, 0.10,
+          "The relative slowdown (in median wall time) considered a regression.");
+ABSL_FLAG(double, noise, 3.0,
+          "Slowdowns must also exceed this many median absolute deviations.");
+
+namespace minimalloc {
+namespace {
+
+struct Case {
+  std::string suite;
+  std::string name;
+  std::string config;
+  std::function<absl::StatusOr<Problem>()> load;
+  SolverParams params;
+};
+
+struct Result {
+  std::string suite;
+  std::string name;
+  std::string config;
+  std::string status;
+  int repetitions = 0;
+  double wall_ms_median = 0;
+  double wall_ms_mad = 0;  // The median absolute deviation.
+  double wall_ms_min = 0;
+  int64_t nodes = 0;
+  int64_t backtracks = 0;
+  int64_t peak_rss_kb = 0;
+  double sweep_ms = 0;
+  double setup_ms = 0;
+  double search_ms = 0;
+
+  std::string key() const { return absl::StrCat(suite, "/", name, "/", config); }
+};
+
+double Median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  const size_t mid = values.size() / 2;
+  return values.size() % 2 ? values[mid]
+                           : (values[mid - 1] + values[mid]) / 2;
+}
+
+// Resets the peak resident set size (where the kernel allows it), so that it
+// can be attributed to a single run.
+void ResetPeakRss() {
+  std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+int64_t PeakRssKb() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (!absl::StartsWith(line, "VmHWM:")) continue;
+    int64_t peak_rss_kb = 0;
+    std::istringstream(line.substr(6)) >> peak_rss_kb;
+    return peak_rss_kb;
+  }
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+double ToMs(absl::Duration duration) {
+  return absl::ToDoubleMilliseconds(duration);
+}
+
+Result Run(const Case& c, int repetitions) {
+  Result result = {.suite = c.suite, .name = c.name, .config = c.config};
+  absl::StatusOr<Problem> problem = c.load();
+  if (!problem.ok()) {
+    result.status = absl::StatusCodeToString(problem.status().code());
+    return result;
+  }
+  std::vector<double> wall_ms, sweep_ms, setup_ms, search_ms;
+  for (int repetition = 0; repetition < repetitions; ++repetition) {
+    ResetPeakRss();
+    Solver solver(c.params);
+    const absl::Time start_time = absl::Now();
+    const absl::StatusOr<Solution> solution = solver.Solve(*problem);
+    wall_ms.push_back(ToMs(absl::Now() - start_time));
+    const SolverStats& stats = solver.get_stats();
+    sweep_ms.push_back(ToMs(stats.sweep_time));
+    setup_ms.push_back(ToMs(stats.setup_time));
+    search_ms.push_back(ToMs(stats.search_time));
+    result.status = absl::StatusCodeToString(solution.status().code());
+    result.nodes = stats.nodes;
+    result.backtracks = stats.backtracks;
+    result.peak_rss_kb = std::max(result.peak_rss_kb, PeakRssKb());
+  }
+  result.repetitions = repetitions;
+  result.wall_ms_median = Median(wall_ms);
+  result.wall_ms_min = *std::min_element(wall_ms.begin(), wall_ms.end());
+  std::vector<double> deviations;
+  for (double ms : wall_ms) {
+    deviations.push_back(std::abs(ms - result.wall_ms_median));
+  }
+  result.wall_ms_mad = Median(deviations);
+  result.sweep_ms = Median(sweep_ms);
+  result.setup_ms = Median(setup_ms);
+  result.search_ms = Median(search_ms);
+  return result;
+}
+
+std::vector<Case> CreateCases() {
+  std::vector<Case> cases;
+  const std::vector<std::string> suites =
+      absl::StrSplit(absl::GetFlag(FLAGS_suites), ',', absl::SkipEmpty());
+  auto has_suite = [&suites](absl::string_view suite) {
+    return std::find(suites.begin(), suites.end(), suite) != suites.end();
+  };
+  const SolverParams defaults = {.timeout = absl::GetFlag(FLAGS_timeout)};
+  std::vector<std::filesystem::path> paths;
+  const std::filesystem::path directory = absl::GetFlag(FLAGS_challenging_dir);
+  if (std::filesystem::is_directory(directory)) {
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+      if (entry.path().extension() == ".csv") paths.push_back(entry.path());
+    }
+  }
+  std::sort(paths.begin(), paths.end());
+  const Capacity capacity = absl::GetFlag(FLAGS_capacity);
+  auto load_csv = [capacity](std::string path) {
+    return [capacity, path]() -> absl::StatusOr<Problem> {
+      absl::StatusOr<Problem> problem = FromCsvFile(path);
+      if (problem.ok()) problem->capacity = capacity;
+      return problem;
+    };
+  };
+  if (has_suite("challenging")) {
+    for (const std::filesystem::path& path : paths) {
+      cases.push_back({"challenging", path.stem().string(), "default",
+                       load_csv(path.string()), defaults});
+    }
+  }
+  if (has_suite("synthetic")) {
+    for (absl::string_view scale :
+         absl::StrSplit(absl::GetFlag(FLAGS_synthetic_scales), ',',
+                        absl::SkipEmpty())) {
+      int64_t num_buffers = 0;
+      if (!absl::SimpleAtoi(scale, &num_buffers)) continue;
+      const GeneratorParams generator_params = {
+          .num_buffers = num_buffers,
+          .num_partitions = std::max<int64_t>(num_buffers / 1000, 1),
+          .size_skew = 1.0,
+          .gap_density = 0.25,
+          .tightness = 0.9};
+      cases.push_back({"synthetic", absl::StrCat(num_buffers), "default",
+                       [generator_params]() {
+                         return Generate(generator_params);
+                       },
+                       defaults});
+    }
+  }
+  if (has_suite("ablation")) {
+    const std::vector<std::pair<std::string, bool SolverParams::*>> flags = {
+        {"canonical_only", &SolverParams::canonical_only},
+        {"section_inference", &SolverParams::section_inference},
+        {"dynamic_ordering", &SolverParams::dynamic_ordering},
+        {"check_dominance", &SolverParams::check_dominance},
+        {"unallocated_floor", &SolverParams::unallocated_floor},
+        {"static_preordering", &SolverParams::static_preordering},
+        {"dynamic_decomposition", &SolverParams::dynamic_decomposition},
+        {"monotonic_floor", &SolverParams::monotonic_floor},
+        {"hatless_pruning", &SolverParams::hatless_pruning},
+        {"deduplicate_partitions", &SolverParams::deduplicate_partitions},
+        {"break_symmetries", &SolverParams::break_symmetries},
+        {"normalize_scale", &SolverParams::normalize_scale},
+        {"small_partition_search", &SolverParams::small_partition_search}};
+    for (const std::filesystem::path& path : paths) {
+      for (const auto& [flag, member] : flags) {
+        SolverParams params = defaults;
+        params.*member = false;
+        cases.push_back({"ablation", path.stem().string(),
+                         absl::StrCat("no_", flag), load_csv(path.string()),
+                         params});
+      }
+      // The dense overlaps are off by default, so measure turning them on.
+      SolverParams params = defaults;
+      params.dense_overlaps = true;
+      cases.push_back({"ablation", path.stem().string(), "with_dense_overlaps",
+                       load_csv(path.string()), params});
+    }
+  }
+  const std::string filter = absl::GetFlag(FLAGS_filter);
+  std::erase_if(cases, [&filter](const Case& c) {
+    return absl::StrCat(c.suite, "/", c.name, "/", c.config).find(filter) ==
+           std::string::npos;
+  });
+  return cases;
+}
+
+// Writes the results with one object per line (which ReadResults expects).
+void WriteResults(const std::vector<Result>& results, std::ostream& os) {
+  os << "{\"results\": [\n";
+  for (int result_idx = 0; result_idx < results.size(); ++result_idx) {
+    const Result& r = results[result_idx];
+    os << "  {\"suite\": \"" << r.suite << "\", \"name\": \"" << r.name
+       << "\", \"config\": \"" << r.config << "\", \"status\": \"" << r.status
+       << "\", \"repetitions\": " << r.repetitions
+       << ", \"wall_ms_median\": " << r.wall_ms_median
+       << ", \"wall_ms_mad\": " << r.wall_ms_mad
+       << ", \"wall_ms_min\": " << r.wall_ms_min
+       << ", \"nodes\": " << r.nodes
+       << ", \"backtracks\": " << r.backtracks
+       << ", \"peak_rss_kb\": " << r.peak_rss_kb
+       << ", \"sweep_ms\": " << r.sweep_ms
+       << ", \"setup_ms\": " << r.setup_ms
+       << ", \"search_ms\": " << r.search_ms << "}"
+       << (result_idx + 1 < results.size() ? "," : "") << "\n";
+  }
+  os << "]}\n";
+}
+
+// Reads the results written by WriteResults, ignoring any unknown keys.
+std::map<std::string, Result> ReadResults(std::istream& is) {
+  std::map<std::string, Result> results;
+  std::string line;
+  while (std::getline(is, line)) {
+    const size_t begin = line.find('{'), end = line.rfind('}');
+    if (begin == std::string::npos || end == std::string::npos) continue;
+    Result r;
+    for (absl::string_view field : absl::StrSplit(
+             absl::string_view(line).substr(begin + 1, end - begin - 1),
+             ", \"")) {
+      std::pair<absl::string_view, absl::string_view> kv =
+          absl::StrSplit(field, absl::MaxSplits("\": ", 1));
+      absl::string_view key = absl::StripPrefix(kv.first, "\"");
+      absl::string_view value = absl::StripSuffix(
+          absl::StripPrefix(kv.second, "\""), "\"");
+      if (key == "suite") r.suite = std::string(value);
+      if (key == "name") r.name = std::string(value);
+      if (key == "config") r.config = std::string(value);
+      if (key == "status") r.status = std::string(value);
+      bool ok = true;
+      if (key == "wall_ms_median") ok = absl::SimpleAtod(value, &r.wall_ms_median);
+      if (key == "wall_ms_mad") ok = absl::SimpleAtod(value, &r.wall_ms_mad);
+      if (key == "nodes") ok = absl::SimpleAtoi(value, &r.nodes);
+      if (key == "backtracks") ok = absl::SimpleAtoi(value, &r.backtracks);
+      if (key == "peak_rss_kb") ok = absl::SimpleAtoi(value, &r.peak_rss_kb);
+      if (!ok) r.suite.clear();  // Skip any malformed entries.
+    }
+    if (!r.suite.empty()) results[r.key()] = r;
+  }
+  return results;
+}
+
+// Prints a comparison of each result against its baseline, and returns the
+// number of regressions.  A slowdown only counts if it exceeds both the
+// relative threshold and the noise observed in either run.
+int Compare(const std::vector<Result>& results,
+            const std::map<std::string, Result>& baseline) {
+  const double threshold = absl::GetFlag(FLAGS_threshold);
+  const double noise = absl::GetFlag(FLAGS_noise);
+  int num_regressions = 0;
+  for (const Result& r : results) {
+    const auto it = baseline.find(r.key());
+    if (it == baseline.end()) {
+      std::cout << r.key() << ": no baseline" << std::endl;
+      continue;
+    }
+    const Result& b = it->second;
+    const double delta = r.wall_ms_median - b.wall_ms_median;
+    const double ratio = b.wall_ms_median > 0 ? delta / b.wall_ms_median : 0;
+    const double spread = noise * std::max(r.wall_ms_mad, b.wall_ms_mad);
+    std::string verdict = "same";
+    if (r.status != b.status) {
+      verdict = absl::StrCat("REGRESSED (status ", b.status, " -> ", r.status,
+                             ")");
+    } else if (ratio > threshold && delta > spread) {
+      verdict = "REGRESSED";
+    } else if (-ratio > threshold && -delta > spread) {
+      verdict = "improved";
+    }
+    if (absl::StartsWith(verdict, "REGRESSED")) ++num_regressions;
+    std::cout << r.key() << ": " << b.wall_ms_median << "ms -> "
+              << r.wall_ms_median << "ms (" << (ratio >= 0 ? "+" : "")
+              << 100 * ratio << "%) " << verdict;
+    if (r.nodes != b.nodes || r.backtracks != b.backtracks) {
+      std::cout << " [nodes " << b.nodes << " -> " << r.nodes
+                << ", backtracks " << b.backtracks << " -> " << r.backtracks
+                << "]";
+    }
+    std::cout << std::endl;
+  }
+  return num_regressions;
+}
+
+}  // namespace
+}  // namespace minimalloc
+
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  const int repetitions = std::max(absl::GetFlag(FLAGS_repetitions), 1);
+  std::vector<minimalloc::Result> results;
+  for (const minimalloc::Case& c : minimalloc::CreateCases()) {
+    results.push_back(minimalloc::Run(c, repetitions));
+    const minimalloc::Result& r = results.back();
+    std::cerr << r.key() << ": " << r.status << " " << r.wall_ms_median
+              << "ms" << std::endl;
+  }
+  if (const std::string output = absl::GetFlag(FLAGS_output); !output.empty()) {
+    std::ofstream ofs(output);
+    minimalloc::WriteResults(results, ofs);
+  } else {
+    minimalloc::WriteResults(results, std::cout);
+  }
+  if (const std::string path = absl::GetFlag(FLAGS_baseline); !path.empty()) {
+    std::ifstream ifs(path);
+    if (!ifs) {
+      std::cerr << "Unable to read baseline: " << path << std::endl;
+      return 1;
+    }
+    if (minimalloc::Compare(results, minimalloc::ReadResults(ifs)) > 0) {
+      return 2;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,186 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../src/converter.h"
+#include "../src/generator.h"
+#include "../src/minimalloc.h"
+#include "../src/solver.h"
+#include "../src/sweeper.h"
+#include "../src/validator.h"
+#include "absl/status/statusor.h"
+#include "benchmark/benchmark.h"
+
+namespace minimalloc {
+namespace {
+
+constexpr Capacity kChallengingCapacity = 1048576;
+
+// Generates a problem (with some gaps) and optionally stacks its buffers on
+// top of one another, for a trivially valid solution.
+Problem CreateProblem(int64_t num_buffers, Solution* solution = nullptr) {
+  absl::StatusOr<Problem> problem = Generate({
+      .num_buffers = num_buffers,
+      .max_length = 64,
+      .max_size = 1024,
+      .size_skew = 1.0,
+      .alignments = {{.alignment = 1}, {.alignment = 8}},
+      .gap_density = 0.25,
+      .seed = static_cast<uint64_t>(num_buffers)});
+  if (solution) {
+    problem->capacity = 0;
+    for (const Buffer& buffer : problem->buffers) {
+      const int64_t alignment = buffer.alignment;
+      problem->capacity = (problem->capacity + alignment - 1) / alignment *
+                          alignment;
+      solution->offsets.push_back(problem->capacity);
+      problem->capacity += buffer.size;
+    }
+  }
+  return *std::move(problem);
+}
+
+void BM_EffectiveSize(benchmark::State& state) {
+  const int64_t num_gaps = state.range(0);
+  Buffer buffer = {.lifespan = {0, 4 * num_gaps + 4}, .size = 4};
+  Buffer other = {.lifespan = {1, 4 * num_gaps + 5}, .size = 4};
+  for (int64_t gap_idx = 0; gap_idx < num_gaps; ++gap_idx) {
+    buffer.gaps.push_back({.lifespan = {4 * gap_idx + 1, 4 * gap_idx + 2}});
+    other.gaps.push_back({.lifespan = {4 * gap_idx + 2, 4 * gap_idx + 3},
+                          .window = {{0, 2}}});
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(buffer.effective_size(other));
+  }
+}
+BENCHMARK(BM_EffectiveSize)->Arg(0)->Arg(1)->Arg(8)->Arg(64);
+
+void BM_CreatePoints(benchmark::State& state) {
+  const Problem problem = CreateProblem(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(CreatePoints(problem));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CreatePoints)->RangeMultiplier(8)->Range(1 << 8, 1 << 17);
+
+void BM_Sweep(benchmark::State& state) {
+  const Problem problem = CreateProblem(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Sweep(problem));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Sweep)->RangeMultiplier(8)->Range(1 << 8, 1 << 17);
+
+void BM_CalculateCuts(benchmark::State& state) {
+  const SweepResult sweep_result = Sweep(CreateProblem(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(sweep_result.CalculateCuts());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CalculateCuts)->RangeMultiplier(8)->Range(1 << 8, 1 << 17);
+
+void BM_FromCsv(benchmark::State& state) {
+  const std::string csv = ToCsv(CreateProblem(state.range(0)));
+  const int num_threads = state.range(1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(FromCsv(csv, num_threads));
+  }
+  state.SetBytesProcessed(state.iterations() * csv.size());
+}
+BENCHMARK(BM_FromCsv)
+    ->ArgsProduct({{1 << 8, 1 << 12, 1 << 16, 1 << 20}, {1, 4}})
+    ->UseRealTime();
+
+void BM_ToCsv(benchmark::State& state) {
+  Solution solution;
+  const Problem problem = CreateProblem(state.range(0), &solution);
+  int64_t num_bytes = 0;
+  for (auto _ : state) {
+    const std::string csv = ToCsv(problem, &solution);
+    num_bytes += csv.size();
+    benchmark::DoNotOptimize(csv);
+  }
+  state.SetBytesProcessed(num_bytes);
+}
+BENCHMARK(BM_ToCsv)->RangeMultiplier(16)->Range(1 << 8, 1 << 20);
+
+void BM_Validate(benchmark::State& state) {
+  Solution solution;
+  const Problem problem = CreateProblem(state.range(0), &solution);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Validate(problem, solution));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Validate)->RangeMultiplier(8)->Range(1 << 8, 1 << 20);
+
+void BM_Solve(benchmark::State& state, const Problem& problem) {
+  int64_t backtracks = 0;
+  for (auto _ : state) {
+    Solver solver;
+    absl::StatusOr<Solution> solution = solver.Solve(problem);
+    if (!solution.ok()) state.SkipWithError("Solver failed");
+    backtracks += solver.get_backtracks();
+  }
+  state.counters["backtracks"] = benchmark::Counter(
+      backtracks, benchmark::Counter::kAvgIterations);
+}
+
+// Registers a solver benchmark for each file in the challenging suite.
+void RegisterChallengingBenchmarks() {
+  static std::vector<Problem>* problems = new std::vector<Problem>();
+  const std::filesystem::path directory =
+      std::filesystem::path(MINIMALLOC_BENCHMARKS_DIR) / "challenging";
+  if (!std::filesystem::is_directory(directory)) return;
+  std::vector<std::filesystem::path> paths;
+  for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+    if (entry.path().extension() == ".csv") paths.push_back(entry.path());
+  }
+  std::sort(paths.begin(), paths.end());
+  problems->reserve(paths.size());
+  for (const std::filesystem::path& path : paths) {
+    absl::StatusOr<Problem> problem = FromCsvFile(path.string());
+    if (!problem.ok()) continue;
+    problem->capacity = kChallengingCapacity;
+    problems->push_back(*std::move(problem));
+    benchmark::RegisterBenchmark(
+        ("BM_Solve/" + path.stem().string()).c_str(), BM_Solve,
+        problems->back())
+        ->Unit(benchmark::kMillisecond)
+        ->Iterations(1);
+  }
+}
+
+}  // namespace
+}  // namespace minimalloc
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  minimalloc::RegisterChallengingBenchmarks();
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
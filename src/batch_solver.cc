@@ -0,0 +1,135 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "batch_solver.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "minimalloc.h"
+#include "solution_cache.h"
+#include "solver.h"
+#include "thread_pool.h"
+
+namespace minimalloc {
+
+void SolveBatch(const Solver& solver, std::span<const Problem> problems,
+                int num_threads, const BatchCallback& callback,
+                const SolutionCache* cache) {
+  // Larger problems are started first, so that they don't end up as stragglers.
+  std::vector<int64_t> order(problems.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [problems](int64_t a, int64_t b) {
+    return problems[a].buffers.size() > problems[b].buffers.size();
+  });
+  absl::Mutex mutex;
+  ThreadPool thread_pool(
+      std::min<int64_t>(num_threads, std::max<int64_t>(problems.size(), 1)));
+  for (const int64_t problem_idx : order) {
+    thread_pool.Schedule([&solver, &problems, &callback, &mutex, cache,
+                          problem_idx]() {
+      SolveContext context;
+      absl::StatusOr<Solution> solution = cache
+          ? SolveWithCache(solver, *cache, problems[problem_idx], context)
+          : solver.Solve(problems[problem_idx], context);
+      absl::MutexLock lock(&mutex);
+      callback({.problem_idx = problem_idx,
+                .solution = std::move(solution),
+                .stats = context.get_stats()});
+    });
+  }
+}  // The thread pool's destructor waits for every solve to finish.
+
+std::vector<absl::StatusOr<Solution>> SolveBatch(
+    const Solver& solver, std::span<const Problem> problems, int num_threads,
+    const SolutionCache* cache) {
+  std::vector<absl::StatusOr<Solution>> solutions(problems.size());
+  SolveBatch(solver, problems, num_threads, [&solutions](BatchResult result) {
+    solutions[result.problem_idx] = std::move(result.solution);
+  }, cache);
+  return solutions;
+}
+
+absl::StatusOr<std::vector<BatchInput>> ListBatchInputs(
+    const std::string& dir, std::optional<int64_t> capacity) {
+  std::error_code error;
+  std::filesystem::directory_iterator it(dir, error);
+  if (error) {
+    return absl::NotFoundError(absl::StrCat("Cannot read directory ", dir));
+  }
+  std::vector<BatchInput> inputs;
+  for (const std::filesystem::directory_entry& entry : it) {
+    if (!entry.is_regular_file()) continue;
+    inputs.push_back({.path = entry.path().string(), .capacity = capacity});
+  }
+  std::sort(inputs.begin(), inputs.end(),
+            [](const BatchInput& a, const BatchInput& b) {
+              return a.path < b.path;
+            });
+  return inputs;
+}
+
+absl::StatusOr<std::vector<BatchInput>> ReadBatchManifest(
+    const std::string& path, std::optional<int64_t> capacity) {
+  std::ifstream ifs(path);
+  if (!ifs) return absl::NotFoundError(absl::StrCat("Cannot open ", path));
+  const std::filesystem::path base = std::filesystem::path(path).parent_path();
+  std::vector<BatchInput> inputs;
+  std::string line;
+  while (std::getline(ifs, line)) {
+    const absl::string_view entry = absl::StripAsciiWhitespace(line);
+    if (entry.empty() || entry.front() == '#') continue;
+    BatchInput input = {.capacity = capacity};
+    absl::string_view input_path = entry;
+    if (const size_t comma = entry.rfind(','); comma != entry.npos) {
+      input_path = absl::StripAsciiWhitespace(entry.substr(0, comma));
+      int64_t entry_capacity = 0;
+      if (!absl::SimpleAtoi(entry.substr(comma + 1), &entry_capacity) ||
+          entry_capacity < 0) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Improperly formed capacity: ", entry));
+      }
+      input.capacity = entry_capacity;
+    }
+    if (input_path.empty()) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Missing path: ", entry));
+    }
+    std::filesystem::path file = std::string(input_path);
+    if (file.is_relative()) file = base / file;
+    input.path = file.string();
+    inputs.push_back(std::move(input));
+  }
+  return inputs;
+}
+
+}  // namespace minimalloc
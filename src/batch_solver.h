@@ -0,0 +1,79 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef MINIMALLOC_SRC_BATCH_SOLVER_H_
+#define MINIMALLOC_SRC_BATCH_SOLVER_H_
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "minimalloc.h"
+#include "solution_cache.h"
+#include "solver.h"
+
+namespace minimalloc {
+
+// The outcome of solving one problem of a batch.
+struct BatchResult {
+  int64_t problem_idx;  // An index into the batch.
+  absl::StatusOr<Solution> solution;
+  SolverStats stats;
+};
+
+// Invoked once per problem, as soon as its solve completes.  Invocations are
+// serialized, so the callback needn't be thread-safe.
+using BatchCallback = std::function<void(BatchResult result)>;
+
+// Solves every problem on a pool of num_threads workers, starting with the
+// largest (ie, those with the most buffers), and returns once all are done.
+// If a cache is given, it is consulted (and populated) via SolveWithCache.
+void SolveBatch(const Solver& solver, std::span<const Problem> problems,
+                int num_threads, const BatchCallback& callback,
+                const SolutionCache* cache = nullptr);
+
+// As above, but collects the solutions in the order of the given problems.
+std::vector<absl::StatusOr<Solution>> SolveBatch(
+    const Solver& solver, std::span<const Problem> problems, int num_threads,
+    const SolutionCache* cache = nullptr);
+
+// A file to be solved as part of a batch.  If given, its capacity overrides any
+// stored in the file itself (as binary inputs do).
+struct BatchInput {
+  std::string path;
+  std::optional<int64_t> capacity;
+  bool operator==(const BatchInput& x) const = default;
+};
+
+// Lists the regular files in a directory (sorted by path), each having the
+// given capacity (if any).
+absl::StatusOr<std::vector<BatchInput>> ListBatchInputs(
+    const std::string& dir, std::optional<int64_t> capacity);
+
+// Reads a manifest with one "path[,capacity]" entry per line, where blank lines
+// and those starting with '#' are ignored.  Relative paths are resolved against
+// the manifest's directory, and missing capacities use the given default (if
+// any).
+absl::StatusOr<std::vector<BatchInput>> ReadBatchManifest(
+    const std::string& path, std::optional<int64_t> capacity);
+
+}  // namespace minimalloc
+
+#endif  // MINIMALLOC_SRC_BATCH_SOLVER_H_
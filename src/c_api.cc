@@ -0,0 +1,283 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "c_api.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/time.h"
+#include "minimalloc.h"
+#include "solver.h"
+
+struct mm_problem {
+  minimalloc::Problem problem;
+};
+
+struct mm_solver {
+  explicit mm_solver(const minimalloc::SolverParams& params) : solver(params) {}
+  minimalloc::Solver solver;
+};
+
+struct mm_context {
+  minimalloc::SolveContext context;
+};
+
+struct mm_solution {
+  std::vector<int64_t> offsets;
+};
+
+namespace {
+
+mm_status ToStatus(const absl::Status& status) {
+  switch (status.code()) {
+    case absl::StatusCode::kOk: return MM_OK;
+    case absl::StatusCode::kInvalidArgument: return MM_INVALID_ARGUMENT;
+    case absl::StatusCode::kNotFound: return MM_NOT_FOUND;
+    case absl::StatusCode::kDeadlineExceeded: return MM_DEADLINE_EXCEEDED;
+    default: return MM_INTERNAL;
+  }
+}
+
+bool IsValidBuffer(const mm_problem* problem, int64_t buffer_idx) {
+  return problem && buffer_idx >= 0 &&
+         buffer_idx < problem->problem.buffers.size();
+}
+
+void ToStats(const minimalloc::SolverStats& solver_stats,
+             mm_solver_stats* stats) {
+  *stats = {
+      .backtracks = solver_stats.backtracks,
+      .nodes = solver_stats.nodes,
+      .sweep_seconds = absl::ToDoubleSeconds(solver_stats.sweep_time),
+      .setup_seconds = absl::ToDoubleSeconds(solver_stats.setup_time),
+      .search_seconds = absl::ToDoubleSeconds(solver_stats.search_time),
+  };
+}
+
+mm_status ToSolution(absl::StatusOr<minimalloc::Solution> result,
+                     mm_solution** solution) {
+  if (!result.ok()) return ToStatus(result.status());
+  *solution = new mm_solution{std::move(result->offsets)};
+  return MM_OK;
+}
+
+}  // namespace
+
+extern "C" {
+
+mm_problem* mm_problem_create(int64_t num_buffers, const int64_t* lowers,
+                              const int64_t* uppers, const int64_t* sizes,
+                              const int64_t* alignments, int64_t capacity) {
+  try {
+    if (num_buffers < 0 || capacity < 0) return nullptr;
+    if (num_buffers > 0 && (!lowers || !uppers || !sizes)) return nullptr;
+    minimalloc::Problem problem = {.capacity = capacity};
+    problem.buffers.reserve(num_buffers);
+    for (int64_t buffer_idx = 0; buffer_idx < num_buffers; ++buffer_idx) {
+      const int64_t alignment = alignments ? alignments[buffer_idx] : 1;
+      if (lowers[buffer_idx] > uppers[buffer_idx] || sizes[buffer_idx] < 0 ||
+          alignment < 1) {
+        return nullptr;
+      }
+      problem.buffers.push_back({.lifespan = {lowers[buffer_idx],
+                                              uppers[buffer_idx]},
+                                 .size = sizes[buffer_idx],
+                                 .alignment = alignment});
+    }
+    return new mm_problem{std::move(problem)};
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+mm_status mm_problem_add_gap(mm_problem* problem, int64_t buffer_idx,
+                             int64_t lower, int64_t upper, int has_window,
+                             int64_t window_lower, int64_t window_upper) {
+  if (!IsValidBuffer(problem, buffer_idx)) return MM_INVALID_ARGUMENT;
+  minimalloc::Buffer& buffer = problem->problem.buffers[buffer_idx];
+  if (lower > upper || lower < buffer.lifespan.lower() ||
+      upper > buffer.lifespan.upper()) {
+    return MM_INVALID_ARGUMENT;
+  }
+  minimalloc::Gap gap = {.lifespan = {lower, upper}};
+  if (has_window) {
+    if (window_lower < 0 || window_lower > window_upper ||
+        window_upper > buffer.size) {
+      return MM_INVALID_ARGUMENT;
+    }
+    gap.window = {window_lower, window_upper};
+  }
+  try {
+    buffer.gaps.push_back(gap);
+  } catch (...) {
+    return MM_INTERNAL;
+  }
+  return MM_OK;
+}
+
+mm_status mm_problem_set_fixed_offset(mm_problem* problem, int64_t buffer_idx,
+                                      int64_t offset) {
+  if (!IsValidBuffer(problem, buffer_idx)) return MM_INVALID_ARGUMENT;
+  problem->problem.buffers[buffer_idx].offset = offset;
+  return MM_OK;
+}
+
+void mm_problem_destroy(mm_problem* problem) { delete problem; }
+
+void mm_solver_params_init(mm_solver_params* params) {
+  if (!params) return;
+  try {
+    const minimalloc::SolverParams defaults;
+    *params = {
+        .struct_size = sizeof(mm_solver_params),
+        .timeout_seconds = 0,
+        .canonical_only = defaults.canonical_only,
+        .section_inference = defaults.section_inference,
+        .dynamic_ordering = defaults.dynamic_ordering,
+        .check_dominance = defaults.check_dominance,
+        .unallocated_floor = defaults.unallocated_floor,
+        .static_preordering = defaults.static_preordering,
+        .dynamic_decomposition = defaults.dynamic_decomposition,
+        .monotonic_floor = defaults.monotonic_floor,
+        .hatless_pruning = defaults.hatless_pruning,
+        .preordering_heuristics = nullptr,
+        .deduplicate_partitions = defaults.deduplicate_partitions,
+        .break_symmetries = defaults.break_symmetries,
+        .normalize_scale = defaults.normalize_scale,
+        .small_partition_search = defaults.small_partition_search,
+        .dense_overlaps = defaults.dense_overlaps,
+    };
+  } catch (...) {
+    *params = {};  // A struct_size of zero, which mm_solver_create rejects.
+  }
+}
+
+mm_solver* mm_solver_create(const mm_solver_params* params) {
+  mm_solver_params c_params;
+  mm_solver_params_init(&c_params);
+  if (c_params.struct_size == 0) return nullptr;
+  if (params) {
+    // Fields beyond those the caller knows of keep their defaults.
+    if (params->struct_size < offsetof(mm_solver_params, timeout_seconds)) {
+      return nullptr;
+    }
+    std::memcpy(&c_params, params,
+                std::min(params->struct_size, sizeof(mm_solver_params)));
+  }
+  try {
+    minimalloc::SolverParams solver_params = {
+        .canonical_only = c_params.canonical_only != 0,
+        .section_inference = c_params.section_inference != 0,
+        .dynamic_ordering = c_params.dynamic_ordering != 0,
+        .check_dominance = c_params.check_dominance != 0,
+        .unallocated_floor = c_params.unallocated_floor != 0,
+        .static_preordering = c_params.static_preordering != 0,
+        .dynamic_decomposition = c_params.dynamic_decomposition != 0,
+        .monotonic_floor = c_params.monotonic_floor != 0,
+        .hatless_pruning = c_params.hatless_pruning != 0,
+        .deduplicate_partitions = c_params.deduplicate_partitions != 0,
+        .break_symmetries = c_params.break_symmetries != 0,
+        .normalize_scale = c_params.normalize_scale != 0,
+        .small_partition_search = c_params.small_partition_search != 0,
+        .dense_overlaps = c_params.dense_overlaps != 0,
+    };
+    if (c_params.timeout_seconds > 0) {
+      solver_params.timeout = absl::Seconds(c_params.timeout_seconds);
+    }
+    if (c_params.preordering_heuristics) {
+      solver_params.preordering_heuristics = absl::StrSplit(
+          c_params.preordering_heuristics, ',', absl::SkipEmpty());
+      if (solver_params.preordering_heuristics.empty()) return nullptr;
+    }
+    return new mm_solver(solver_params);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void mm_solver_destroy(mm_solver* solver) { delete solver; }
+
+mm_status mm_solve(mm_solver* solver, const mm_problem* problem,
+                   mm_solution** solution) {
+  if (!solver || !problem || !solution) return MM_INVALID_ARGUMENT;
+  try {
+    return ToSolution(solver->solver.Solve(problem->problem), solution);
+  } catch (...) {
+    return MM_INTERNAL;
+  }
+}
+
+void mm_solver_cancel(mm_solver* solver) {
+  if (solver) solver->solver.Cancel();
+}
+
+mm_status mm_solver_get_stats(const mm_solver* solver, mm_solver_stats* stats) {
+  if (!solver || !stats) return MM_INVALID_ARGUMENT;
+  ToStats(solver->solver.get_stats(), stats);
+  return MM_OK;
+}
+
+mm_context* mm_context_create(void) {
+  try {
+    return new mm_context;
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void mm_context_destroy(mm_context* context) { delete context; }
+
+mm_status mm_solve_with_context(const mm_solver* solver, mm_context* context,
+                                const mm_problem* problem,
+                                mm_solution** solution) {
+  if (!solver || !context || !problem || !solution) return MM_INVALID_ARGUMENT;
+  try {
+    return ToSolution(solver->solver.Solve(problem->problem, context->context),
+                      solution);
+  } catch (...) {
+    return MM_INTERNAL;
+  }
+}
+
+void mm_context_cancel(mm_context* context) {
+  if (context) context->context.Cancel();
+}
+
+mm_status mm_context_get_stats(const mm_context* context,
+                               mm_solver_stats* stats) {
+  if (!context || !stats) return MM_INVALID_ARGUMENT;
+  ToStats(context->context.get_stats(), stats);
+  return MM_OK;
+}
+
+const int64_t* mm_solution_get_offsets(const mm_solution* solution,
+                                       int64_t* num_offsets) {
+  if (!solution) return nullptr;
+  if (num_offsets) *num_offsets = solution->offsets.size();
+  return solution->offsets.data();
+}
+
+void mm_solution_destroy(mm_solution* solution) { delete solution; }
+
+}  // extern "C"
@@ -0,0 +1,147 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// A C interface to the MiniMalloc solver, for embedding it in-process.  All
+// objects are opaque and owned by the caller, who must release them with the
+// corresponding destroy function.  No function lets an exception escape: any
+// unexpected failure (such as running out of memory) yields MM_INTERNAL, or a
+// null object from the create functions.
+
+#ifndef MINIMALLOC_SRC_C_API_H_
+#define MINIMALLOC_SRC_C_API_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mm_problem mm_problem;
+typedef struct mm_solver mm_solver;
+typedef struct mm_solution mm_solution;
+typedef struct mm_context mm_context;
+
+typedef enum mm_status {
+  MM_OK = 0,
+  MM_INVALID_ARGUMENT = 1,  // A null or otherwise malformed argument.
+  MM_NOT_FOUND = 2,  // The problem is infeasible.
+  MM_DEADLINE_EXCEEDED = 3,  // The solver timed out or was cancelled.
+  MM_INTERNAL = 4,  // Any other failure.
+} mm_status;
+
+// Settings that mirror the C++ SolverParams (see solver.h).  New fields are
+// only ever appended, and struct_size records how many a caller knows of, so
+// that those beyond it take their defaults.
+typedef struct mm_solver_params {
+  size_t struct_size;  // Set by mm_solver_params_init.
+  double timeout_seconds;  // Zero or less means no timeout.
+  int canonical_only;
+  int section_inference;
+  int dynamic_ordering;
+  int check_dominance;
+  int unallocated_floor;
+  int static_preordering;
+  int dynamic_decomposition;
+  int monotonic_floor;
+  int hatless_pruning;
+  const char* preordering_heuristics;  // eg. "WAT,TAW,TWA" (null for default).
+  int deduplicate_partitions;
+  int break_symmetries;
+  int normalize_scale;
+  int small_partition_search;
+  int dense_overlaps;
+} mm_solver_params;
+
+typedef struct mm_solver_stats {
+  int64_t backtracks;
+  int64_t nodes;
+  double sweep_seconds;
+  double setup_seconds;
+  double search_seconds;
+} mm_solver_stats;
+
+// Creates a problem from flat arrays of num_buffers elements each, where
+// buffer i lives over the half-open interval [lowers[i], uppers[i]).  The
+// alignments may be null (for an alignment of one).  Returns null if any of
+// the arguments are invalid.
+mm_problem* mm_problem_create(int64_t num_buffers, const int64_t* lowers,
+                              const int64_t* uppers, const int64_t* sizes,
+                              const int64_t* alignments, int64_t capacity);
+
+// Adds a gap to a buffer, in which it occupies [window_lower, window_upper)
+// relative to its offset (or nothing at all if has_window is zero).
+mm_status mm_problem_add_gap(mm_problem* problem, int64_t buffer_idx,
+                             int64_t lower, int64_t upper, int has_window,
+                             int64_t window_lower, int64_t window_upper);
+
+// Pins a buffer to the given offset.
+mm_status mm_problem_set_fixed_offset(mm_problem* problem, int64_t buffer_idx,
+                                      int64_t offset);
+
+void mm_problem_destroy(mm_problem* problem);
+
+// Fills in the default parameters (and the struct_size).
+void mm_solver_params_init(mm_solver_params* params);
+
+// Creates a solver (with the default parameters if params is null).  Returns
+// null if the parameters are invalid, including if their struct_size is unset.
+mm_solver* mm_solver_create(const mm_solver_params* params);
+
+void mm_solver_destroy(mm_solver* solver);
+
+// Solves the problem, and on success stores a newly created solution.
+mm_status mm_solve(mm_solver* solver, const mm_problem* problem,
+                   mm_solution** solution);
+
+// Requests that a solve in progress (on another thread) stop early.
+void mm_solver_cancel(mm_solver* solver);
+
+// Retrieves the statistics of the solver's latest (completed) solve.
+mm_status mm_solver_get_stats(const mm_solver* solver, mm_solver_stats* stats);
+
+// Creates a context that holds the state of a single solve, so that a shared
+// solver may be used by several threads at once.
+mm_context* mm_context_create(void);
+
+void mm_context_destroy(mm_context* context);
+
+// Solves the problem like mm_solve, but records its statistics in the given
+// context (and may be cancelled via it).  Safe to call concurrently on the same
+// solver, so long as each call is given its own context.
+mm_status mm_solve_with_context(const mm_solver* solver, mm_context* context,
+                                const mm_problem* problem,
+                                mm_solution** solution);
+
+// Requests that the solve using this context stop early.
+void mm_context_cancel(mm_context* context);
+
+// Retrieves the statistics recorded in the context.
+mm_status mm_context_get_stats(const mm_context* context,
+                               mm_solver_stats* stats);
+
+// Returns the offset of each buffer (valid for the lifetime of the solution),
+// and stores the number of offsets if num_offsets is non-null.
+const int64_t* mm_solution_get_offsets(const mm_solution* solution,
+                                       int64_t* num_offsets);
+
+void mm_solution_destroy(mm_solution* solution);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // MINIMALLOC_SRC_C_API_H_
@@ -16,22 +16,34 @@ limitations under the License.
 
 #include "converter.h"
 
+#include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
 #include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <ostream>
 #include <sstream>
 #include <string>
+#include <system_error>
+#include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
-#include "absl/strings/numbers.h"
+#include "absl/strings/ascii.h"
 #include "absl/strings/str_cat.h"
-#include "absl/strings/str_join.h"
-#include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
+#include "mapped_file.h"
 #include "minimalloc.h"
+#include "thread_pool.h"
 
 namespace minimalloc {
 
@@ -51,6 +63,36 @@ constexpr absl::string_view kSize = "size";
 constexpr absl::string_view kStart = "start";
 constexpr absl::string_view kUpper = "upper";
 
+// Parallel parsing splits the records into a few chunks per thread (to balance
+// their load), so long as each chunk contains at least this many bytes.
+constexpr int kChunksPerThread = 4;
+constexpr int64_t kMinChunkSize = 1 << 16;
+
+// The binary format begins with this magic value, followed by its version.
+constexpr char kBinaryMagic[8] = {'M', 'I', 'N', 'I', 'M', 'A', 'L', 'C'};
+constexpr uint32_t kBinaryVersion = 1;
+
+// The fixed-size header at the start of the binary format.
+struct BinaryHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;  // Reserved for future use.
+  int64_t num_buffers;
+  int64_t num_gaps;
+  int64_t id_bytes;
+  Capacity capacity;
+};
+static_assert(sizeof(BinaryHeader) == 48);
+
+// Rounds a byte count up to the next multiple of eight.
+int64_t PadToWord(int64_t bytes) { return (bytes + 7) & ~int64_t{7}; }
+
+// Appends a value to a binary output as eight little-endian bytes.
+void AppendInt64(std::string& output, int64_t value) {
+  const uint64_t bits = value;
+  for (int byte = 0; byte < 8; ++byte) output.push_back(bits >> (8 * byte));
+}
+
 bool IncludeAlignment(const Problem& problem) {
   for (const Buffer& buffer : problem.buffers) {
     if (buffer.alignment != 1) return true;
@@ -72,168 +114,592 @@ bool IncludeGaps(const Problem& problem) {
   return false;
 }
 
-}  // namespace
+// The position of each known column within a CSV header (or -1 if absent).
+struct CsvColumns {
+  int num_fields = 0;
+  int id = -1;
+  int lower = -1;
+  int upper = -1;
+  int size = -1;
+  int alignment = -1;
+  int hint = -1;
+  int gaps = -1;
+  int offset = -1;
+  int64_t addend = 0;  // Values of an "end" column are assumed to be off-by-one
+};
 
-std::string ToCsv(const Problem& problem, Solution* solution, bool old_format) {
-  const bool include_alignment = IncludeAlignment(problem);
-  const bool include_hint = IncludeHint(problem);
-  const bool include_gaps = IncludeGaps(problem);
-  const int addend = old_format ? -1 : 0;
-  std::vector<std::string> header = {std::string(kId),
-                                     std::string(old_format ? kStart : kLower),
-                                     std::string(old_format ? kEnd : kUpper),
-                                     std::string(kSize)};
-  if (include_alignment) header.push_back(std::string(kAlignment));
-  if (include_hint) header.push_back(std::string(kHint));
-  if (include_gaps) header.push_back(std::string(kGaps));
-  if (solution) header.push_back(std::string(kOffset));
-  std::vector<std::vector<std::string>> input = { header };
-  for (auto buffer_idx = 0; buffer_idx < problem.buffers.size(); ++buffer_idx) {
-    const Buffer& buffer = problem.buffers[buffer_idx];
-    const auto& lifespan = buffer.lifespan;
-    std::vector<std::string> gaps;
-    gaps.reserve(buffer.gaps.size());
-    for (const Gap& gap : buffer.gaps) {
-      std::string gap_str = absl::StrCat(gap.lifespan.lower(), "-",
-                                         gap.lifespan.upper() + addend);
-      if (gap.window) {
-        gap_str +=
-            absl::StrCat("@", gap.window->lower(), ":", gap.window->upper());
-      }
-      gaps.push_back(gap_str);
+// Removes and returns the next line of input (not including its delimiter).
+// The delimiter search is delegated to memchr, which is vectorized by libc.
+absl::string_view NextRecord(absl::string_view& input) {
+  const void* newline = memchr(input.data(), '\n', input.size());
+  const size_t length = newline
+      ? static_cast<const char*>(newline) - input.data() : input.size();
+  const absl::string_view record = input.substr(0, length);
+  input.remove_prefix(std::min(length + 1, input.size()));
+  return record;
+}
+
+// Splits a record into fields, reusing the storage of the given vector.
+void SplitFields(absl::string_view record, char delimiter,
+                 std::vector<absl::string_view>& fields) {
+  fields.clear();
+  while (true) {
+    const void* next = memchr(record.data(), delimiter, record.size());
+    if (!next) break;
+    const size_t length = static_cast<const char*>(next) - record.data();
+    fields.push_back(record.substr(0, length));
+    record.remove_prefix(length + 1);
+  }
+  fields.push_back(record);
+}
+
+// Parses a base-10 integer, accepting the same inputs as absl::SimpleAtoi (ie,
+// surrounding whitespace and an optional leading '+').
+template <typename T>
+bool ParseInteger(absl::string_view field, T* value) {
+  field = absl::StripAsciiWhitespace(field);
+  if (field.size() > 1 && field[0] == '+' && field[1] != '-') {
+    field.remove_prefix(1);
+  }
+  const char* end = field.data() + field.size();
+  const auto [ptr, ec] = std::from_chars(field.data(), end, *value);
+  return ec == std::errc() && ptr == end && !field.empty();
+}
+
+absl::StatusOr<CsvColumns> ParseHeader(absl::string_view header) {
+  CsvColumns columns;
+  absl::flat_hash_map<absl::string_view, int> col_map;
+  std::vector<absl::string_view> fields;
+  SplitFields(header, ',', fields);
+  for (int field_idx = 0; field_idx < fields.size(); ++field_idx) {
+    // If column reads 'buffer_id', change it to 'buffer' for consistency.
+    absl::string_view col_name = fields[field_idx];
+    if (col_name == kBegin) col_name = kLower;
+    if (col_name == kBuffer) col_name = kId;
+    if (col_name == kBufferId) col_name = kId;
+    if (col_name == kEnd) {
+      col_name = kUpper;
+      columns.addend = 1;
     }
-    std::vector<std::string> record = {absl::StrCat(buffer.id),
-                                       absl::StrCat(lifespan.lower()),
-                                       absl::StrCat(lifespan.upper() + addend),
-                                       absl::StrCat(buffer.size)};
-    if (include_alignment) record.push_back(absl::StrCat(buffer.alignment));
-    if (include_hint) record.push_back(absl::StrCat(buffer.hint.value_or(-1)));
-    if (include_gaps) record.push_back(absl::StrJoin(gaps, " "));
-    if (solution) record.push_back(absl::StrCat(solution->offsets[buffer_idx]));
-    input.push_back(record);
+    if (col_name == kStart) col_name = kLower;
+    col_map[col_name] = field_idx;
   }
-  std::ostringstream oss;
-  for (const auto& record : input) {
-    oss << absl::StrJoin(record, ",") << std::endl;
+  if (col_map.size() != fields.size()) {
+    return absl::InvalidArgumentError("Duplicate column names");
   }
-  return oss.str();
+  if (!col_map.contains(kId) || !col_map.contains(kLower) ||
+      !col_map.contains(kUpper) || !col_map.contains(kSize)) {
+    return absl::NotFoundError("A required column is missing");
+  }
+  const auto find = [&col_map](absl::string_view col_name) {
+    const auto it = col_map.find(col_name);
+    return it == col_map.end() ? -1 : it->second;
+  };
+  columns.num_fields = fields.size();
+  columns.id = find(kId);
+  columns.lower = find(kLower);
+  columns.upper = find(kUpper);
+  columns.size = find(kSize);
+  columns.alignment = find(kAlignment);
+  columns.hint = find(kHint);
+  columns.gaps = find(kGaps);
+  columns.offset = find(kOffset);
+  return columns;
 }
 
-absl::StatusOr<Problem> FromCsv(absl::string_view input) {
-  int64_t addend = 0;
-  Problem problem;
-  absl::flat_hash_map<std::string, int> col_map;
-  std::vector<absl::string_view> records = absl::StrSplit(input, '\n');
-  for (const std::string_view& record : records) {
-    if (record.empty()) break;
-    std::vector<absl::string_view> fields = absl::StrSplit(record, ',');
-    if (col_map.empty()) {  // Need to read header row (to determine columns).
-      for (int field_idx = 0; field_idx < fields.size(); ++field_idx) {
-        // If column reads 'buffer_id', change it to 'buffer' for consistency.
-        absl::string_view col_name = fields[field_idx];
-        if (col_name == kBegin) col_name = kLower;
-        if (col_name == kBuffer) col_name = kId;
-        if (col_name == kBufferId) col_name = kId;
-        if (col_name == kEnd) {
-          col_name = kUpper;
-          addend = 1;  // Values of an "end" column are assumed to be off-by-one
-        }
-        if (col_name == kStart) col_name = kLower;
-        col_map[col_name] = field_idx;
-      }
-      if (col_map.size() != fields.size()) {
-        return absl::InvalidArgumentError("Duplicate column names");
-      }
-      if (!col_map.contains(kId) || !col_map.contains(kLower) ||
-          !col_map.contains(kUpper) || !col_map.contains(kSize)) {
-        return absl::NotFoundError("A required column is missing");
-      }
-      continue;
+absl::Status ParseGap(absl::string_view gap, int64_t addend,
+                      std::vector<Gap>& gaps) {
+  const absl::Status error =
+      absl::InvalidArgumentError(absl::StrCat("Improperly formed gap: ", gap));
+  const size_t at = gap.find('@');
+  const absl::string_view gap_pair = gap.substr(0, at);
+  const size_t dash = gap_pair.find('-');
+  if (dash == absl::string_view::npos ||
+      gap_pair.find('-', dash + 1) != absl::string_view::npos) {
+    return error;
+  }
+  TimeValue gap_lower, gap_upper;
+  if (!ParseInteger(gap_pair.substr(0, dash), &gap_lower) ||
+      !ParseInteger(gap_pair.substr(dash + 1), &gap_upper)) {
+    return error;
+  }
+  std::optional<Window> window;
+  if (at != absl::string_view::npos) {
+    absl::string_view at_pair = gap.substr(at + 1);
+    at_pair = at_pair.substr(0, at_pair.find('@'));
+    const size_t colon = at_pair.find(':');
+    if (colon == absl::string_view::npos ||
+        at_pair.find(':', colon + 1) != absl::string_view::npos) {
+      return error;
     }
-    if (fields.size() != col_map.size()) {
-      return absl::InvalidArgumentError("Too many fields");
+    int64_t window_lower, window_upper;
+    if (!ParseInteger(at_pair.substr(0, colon), &window_lower) ||
+        !ParseInteger(at_pair.substr(colon + 1), &window_upper)) {
+      return error;
     }
-    const std::string& id = static_cast<std::string>(fields[col_map[kId]]);
-    int64_t lower = -1, upper = -1, size = -1;
-    if (!absl::SimpleAtoi(fields[col_map[kLower]], &lower) ||
-        !absl::SimpleAtoi(fields[col_map[kUpper]], &upper) ||
-        !absl::SimpleAtoi(fields[col_map[kSize]], &size)) {
-      return absl::InvalidArgumentError("Improperly formed integer");
+    window = {window_lower, window_upper};
+  }
+  gaps.push_back({.lifespan = {gap_lower, gap_upper + addend},
+                  .window = window});
+  return absl::OkStatus();
+}
+
+// Parses a single record into the given buffer, using 'fields' as scratch.
+absl::Status ParseRecord(absl::string_view record, const CsvColumns& columns,
+                         std::vector<absl::string_view>& fields,
+                         Buffer& buffer) {
+  SplitFields(record, ',', fields);
+  if (fields.size() != columns.num_fields) {
+    return absl::InvalidArgumentError("Too many fields");
+  }
+  buffer.id = std::string(fields[columns.id]);
+  int64_t lower = -1, upper = -1;
+  if (!ParseInteger(fields[columns.lower], &lower) ||
+      !ParseInteger(fields[columns.upper], &upper) ||
+      !ParseInteger(fields[columns.size], &buffer.size)) {
+    return absl::InvalidArgumentError("Improperly formed integer");
+  }
+  buffer.lifespan = {lower, upper + columns.addend};
+  if (columns.alignment >= 0) {
+    if (!ParseInteger(fields[columns.alignment], &buffer.alignment)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Improperly formed alignment: ",
+                       fields[columns.alignment]));
     }
-    int64_t alignment = 1;
-    if (col_map.contains(kAlignment)) {
-      if (!absl::SimpleAtoi(fields[col_map[kAlignment]], &alignment)) {
-        return absl::InvalidArgumentError(
-            absl::StrCat("Improperly formed alignment: ",
-                         fields[col_map[kAlignment]]));
-      }
+  }
+  if (columns.hint >= 0) {
+    Offset hint_val = -1;
+    if (!ParseInteger(fields[columns.hint], &hint_val)) {
+      return absl::InvalidArgumentError("Improperly formed hint");
     }
-    std::optional<Offset> hint;
-    if (col_map.contains(kHint)) {
-      int hint_val = -1;
-      if (!absl::SimpleAtoi(fields[col_map[kHint]], &hint_val)) {
-        return absl::InvalidArgumentError("Improperly formed hint");
-      }
-      if (hint_val >= 0) hint = hint_val;
+    if (hint_val >= 0) buffer.hint = hint_val;
+  }
+  if (columns.gaps >= 0) {
+    absl::string_view gaps_str = fields[columns.gaps];
+    while (!gaps_str.empty()) {
+      const size_t length = std::min(gaps_str.find(' '), gaps_str.size());
+      const absl::string_view gap = gaps_str.substr(0, length);
+      gaps_str.remove_prefix(std::min(length + 1, gaps_str.size()));
+      if (gap.empty()) continue;
+      absl::Status status = ParseGap(gap, columns.addend, buffer.gaps);
+      if (!status.ok()) return status;
     }
-    std::vector<Gap> gaps;
-    if (col_map.contains(kGaps)) {
-      absl::string_view gaps_str = fields[col_map[kGaps]];
-      std::vector<absl::string_view> gaps_list =
-          absl::StrSplit(gaps_str, ' ', absl::SkipEmpty());
-      for (absl::string_view gap : gaps_list) {
-        std::vector<absl::string_view> at = absl::StrSplit(gap, '@');
-        if (at.empty()) {
-          return absl::InvalidArgumentError(
-              absl::StrCat("Improperly formed gap: ", gap));
-        }
-        std::vector<absl::string_view> gap_pair = absl::StrSplit(at[0], '-');
-        if (gap_pair.size() != 2) {
-          return absl::InvalidArgumentError(
-              absl::StrCat("Improperly formed gap: ", gap));
-        }
-        TimeValue gap_lower, gap_upper;
-        if (!absl::SimpleAtoi(gap_pair[0], &gap_lower) ||
-            !absl::SimpleAtoi(gap_pair[1], &gap_upper)) {
-            return absl::InvalidArgumentError(
-                absl::StrCat("Improperly formed gap: ", gap));
-        }
-        std::optional<Window> window;
-        if (at.size() > 1) {
-          std::vector<absl::string_view> at_pair = absl::StrSplit(at[1], ':');
-          if (at_pair.size() != 2) {
-            return absl::InvalidArgumentError(
-                absl::StrCat("Improperly formed gap: ", gap));
-          }
-          int64_t window_lower, window_upper;
-          if (!absl::SimpleAtoi(at_pair[0], &window_lower) ||
-              !absl::SimpleAtoi(at_pair[1], &window_upper)) {
-              return absl::InvalidArgumentError(
-                  absl::StrCat("Improperly formed gap: ", gap));
+  }
+  if (columns.offset >= 0) {
+    Offset offset_val = -1;
+    if (!ParseInteger(fields[columns.offset], &offset_val)) {
+      return absl::InvalidArgumentError("Improperly formed offset");
+    }
+    buffer.offset = offset_val;
+  }
+  return absl::OkStatus();
+}
+
+// The outcome of parsing a sequence of records.
+struct ParsedRecords {
+  absl::Status status;  // The first error encountered (if any).
+  bool stopped = false;  // Whether an empty record ended the sequence early.
+};
+
+// Parses records until the input is exhausted, an error is encountered, or an
+// empty record is reached.
+ParsedRecords ParseRecords(absl::string_view input, const CsvColumns& columns,
+                           std::vector<Buffer>& buffers) {
+  // Reserve one buffer per line, so that records are parsed directly in place.
+  buffers.reserve(buffers.size() + absl::c_count(input, '\n') + 1);
+  std::vector<absl::string_view> fields;
+  while (!input.empty()) {
+    const absl::string_view record = NextRecord(input);
+    if (record.empty()) return {.stopped = true};
+    absl::Status status =
+        ParseRecord(record, columns, fields, buffers.emplace_back());
+    if (!status.ok()) return {.status = status};
+  }
+  return {};
+}
+
+// Streams a CSV through a fixed-size buffer, formatting integers in place and
+// handing full buffers to a sink (eg, a std::ostream or file descriptor).
+class CsvWriter {
+ public:
+  using Sink = std::function<absl::Status(absl::string_view)>;
+
+  explicit CsvWriter(Sink sink) : sink_(std::move(sink)) {}
+
+  absl::Status Write(const Problem& problem, const Solution* solution,
+                     bool old_format) {
+    const bool include_alignment = IncludeAlignment(problem);
+    const bool include_hint = IncludeHint(problem);
+    const bool include_gaps = IncludeGaps(problem);
+    const int addend = old_format ? -1 : 0;
+    Append(kId);
+    Append(',');
+    Append(old_format ? kStart : kLower);
+    Append(',');
+    Append(old_format ? kEnd : kUpper);
+    Append(',');
+    Append(kSize);
+    if (include_alignment) Append(',', kAlignment);
+    if (include_hint) Append(',', kHint);
+    if (include_gaps) Append(',', kGaps);
+    if (solution) Append(',', kOffset);
+    Append('\n');
+    for (auto buffer_idx = 0; buffer_idx < problem.buffers.size();
+         ++buffer_idx) {
+      const Buffer& buffer = problem.buffers[buffer_idx];
+      const auto& lifespan = buffer.lifespan;
+      Append(buffer.id);
+      Append(',', lifespan.lower());
+      Append(',', lifespan.upper() + addend);
+      Append(',', buffer.size);
+      if (include_alignment) Append(',', buffer.alignment);
+      if (include_hint) Append(',', buffer.hint.value_or(-1));
+      if (include_gaps) {
+        Append(',');
+        for (int gap_idx = 0; gap_idx < buffer.gaps.size(); ++gap_idx) {
+          const Gap& gap = buffer.gaps[gap_idx];
+          if (gap_idx > 0) Append(' ');
+          Append(gap.lifespan.lower());
+          Append('-', gap.lifespan.upper() + addend);
+          if (gap.window) {
+            Append('@', gap.window->lower());
+            Append(':', gap.window->upper());
           }
-          window = {window_lower, window_upper};
         }
-        gaps.push_back({.lifespan = {gap_lower, gap_upper + addend},
-                        .window = window});
       }
+      if (solution) Append(',', solution->offsets[buffer_idx]);
+      Append('\n');
+      if (!status_.ok()) return status_;
+    }
+    Flush();
+    return status_;
+  }
+
+ private:
+  // The longest formatted integer (with sign), plus a preceding delimiter.
+  static constexpr int kMaxValueLength = 21;
+
+  void Append(char c) {
+    if (length_ == sizeof(buffer_)) Flush();
+    buffer_[length_++] = c;
+  }
+
+  void Append(absl::string_view str) {
+    while (!str.empty()) {
+      if (length_ == sizeof(buffer_)) Flush();
+      const size_t count = std::min(str.size(), sizeof(buffer_) - length_);
+      memcpy(buffer_ + length_, str.data(), count);
+      length_ += count;
+      str.remove_prefix(count);
+    }
+  }
+
+  void Append(int64_t value) {
+    if (length_ + kMaxValueLength > sizeof(buffer_)) Flush();
+    length_ = std::to_chars(buffer_ + length_, buffer_ + sizeof(buffer_),
+                            value).ptr - buffer_;
+  }
+
+  void Append(char delimiter, absl::string_view str) {
+    Append(delimiter);
+    Append(str);
+  }
+
+  void Append(char delimiter, int64_t value) {
+    Append(delimiter);
+    Append(value);
+  }
+
+  void Flush() {
+    if (status_.ok() && length_ > 0) {
+      status_ = sink_(absl::string_view(buffer_, length_));
+    }
+    length_ = 0;
+  }
+
+  Sink sink_;
+  absl::Status status_;
+  char buffer_[1 << 16];
+  size_t length_ = 0;
+};
+
+}  // namespace
+
+absl::Status WriteCsv(const Problem& problem, std::ostream& os,
+                      const Solution* solution, bool old_format) {
+  auto writer = std::make_unique<CsvWriter>([&os](absl::string_view data) {
+    os.write(data.data(), data.size());
+    return os.good() ? absl::OkStatus()
+                     : absl::DataLossError("Failed to write CSV to stream");
+  });
+  return writer->Write(problem, solution, old_format);
+}
+
+absl::Status WriteCsv(const Problem& problem, int fd,
+                      const Solution* solution, bool old_format) {
+  auto writer = std::make_unique<CsvWriter>([fd](absl::string_view data) {
+    while (!data.empty()) {
+      const ssize_t written = write(fd, data.data(), data.size());
+      if (written < 0 && errno == EINTR) continue;
+      if (written < 0) {
+        return absl::DataLossError("Failed to write CSV to file descriptor");
+      }
+      data.remove_prefix(written);
+    }
+    return absl::OkStatus();
+  });
+  return writer->Write(problem, solution, old_format);
+}
+
+std::string ToCsv(const Problem& problem, Solution* solution, bool old_format) {
+  std::ostringstream oss;
+  WriteCsv(problem, oss, solution, old_format).IgnoreError();
+  return oss.str();
+}
+
+absl::StatusOr<Problem> FromCsv(absl::string_view input) {
+  Problem problem;
+  const absl::string_view header = NextRecord(input);
+  if (header.empty()) return problem;
+  absl::StatusOr<CsvColumns> columns = ParseHeader(header);
+  if (!columns.ok()) return columns.status();
+  const ParsedRecords parsed = ParseRecords(input, *columns, problem.buffers);
+  if (!parsed.status.ok()) return parsed.status;
+  return problem;
+}
+
+absl::StatusOr<Problem> FromCsv(absl::string_view input, int num_threads) {
+  const absl::string_view original_input = input;
+  const absl::string_view header = NextRecord(input);
+  const int num_chunks = std::min<int64_t>(num_threads * kChunksPerThread,
+                                           input.size() / kMinChunkSize);
+  if (header.empty() || num_threads <= 1 || num_chunks <= 1) {
+    return FromCsv(original_input);
+  }
+  absl::StatusOr<CsvColumns> columns = ParseHeader(header);
+  if (!columns.ok()) return columns.status();
+  // Split the records into chunks at newline boundaries.
+  std::vector<absl::string_view> chunks;
+  chunks.reserve(num_chunks);
+  for (int chunk_idx = num_chunks; chunk_idx > 0 && !input.empty();
+       --chunk_idx) {
+    size_t length = input.find('\n', input.size() / chunk_idx);
+    length = length == absl::string_view::npos ? input.size() : length + 1;
+    chunks.push_back(input.substr(0, length));
+    input.remove_prefix(length);
+  }
+  // Parse the chunks in parallel, each into its own list of buffers.
+  std::vector<std::vector<Buffer>> chunk_buffers(chunks.size());
+  std::vector<ParsedRecords> parsed(chunks.size());
+  {
+    ThreadPool thread_pool(num_threads);
+    for (int chunk_idx = 0; chunk_idx < chunks.size(); ++chunk_idx) {
+      thread_pool.Schedule([&, chunk_idx]() {
+        parsed[chunk_idx] = ParseRecords(chunks[chunk_idx], *columns,
+                                         chunk_buffers[chunk_idx]);
+      });
     }
-    std::optional<Offset> offset;
-    if (col_map.contains(kOffset)) {
-      int offset_val = -1;
-      if (!absl::SimpleAtoi(fields[col_map[kOffset]], &offset_val)) {
-        return absl::InvalidArgumentError("Improperly formed offset");
+  }
+  // Concatenate the chunks in order, stopping at the first empty record (and
+  // reporting only those errors encountered before it, as FromCsv would).
+  Problem problem;
+  int num_parsed = 0;
+  size_t num_buffers = 0;
+  while (num_parsed < chunks.size()) {
+    num_buffers += chunk_buffers[num_parsed].size();
+    if (!parsed[num_parsed].status.ok()) return parsed[num_parsed].status;
+    if (parsed[num_parsed++].stopped) break;
+  }
+  problem.buffers.reserve(num_buffers);
+  for (int chunk_idx = 0; chunk_idx < num_parsed; ++chunk_idx) {
+    std::vector<Buffer>& buffers = chunk_buffers[chunk_idx];
+    problem.buffers.insert(problem.buffers.end(),
+                           std::make_move_iterator(buffers.begin()),
+                           std::make_move_iterator(buffers.end()));
+  }
+  return problem;
+}
+
+absl::StatusOr<Problem> FromCsvFile(const std::string& path, int num_threads) {
+  absl::StatusOr<MappedFile> mapped_file = MappedFile::Open(path);
+  if (!mapped_file.ok()) return mapped_file.status();
+  return FromCsv(mapped_file->contents(), num_threads);
+}
+
+std::string ToBinary(const Problem& problem, const Solution* solution) {
+  const std::vector<Buffer>& buffers = problem.buffers;
+  const int64_t num_buffers = buffers.size();
+  int64_t num_gaps = 0, id_bytes = 0;
+  for (const Buffer& buffer : buffers) {
+    num_gaps += buffer.gaps.size();
+    id_bytes += buffer.id.size();
+  }
+  std::string output;
+  output.reserve(sizeof(BinaryHeader) + PadToWord(id_bytes) +
+                 8 * (8 * num_buffers + 2 + 4 * num_gaps));
+  output.append(kBinaryMagic, sizeof(kBinaryMagic));
+  AppendInt64(output, kBinaryVersion);  // The version, followed by no flags.
+  AppendInt64(output, num_buffers);
+  AppendInt64(output, num_gaps);
+  AppendInt64(output, id_bytes);
+  AppendInt64(output, problem.capacity);
+  const auto append_column = [&](auto get) {
+    for (const Buffer& buffer : buffers) AppendInt64(output, get(buffer));
+  };
+  append_column([](const Buffer& b) { return b.lifespan.lower(); });
+  append_column([](const Buffer& b) { return b.lifespan.upper(); });
+  append_column([](const Buffer& b) { return b.size; });
+  append_column([](const Buffer& b) { return b.alignment; });
+  for (BufferIdx buffer_idx = 0; buffer_idx < num_buffers; ++buffer_idx) {
+    const std::optional<Offset>& offset = buffers[buffer_idx].offset;
+    AppendInt64(output, solution ? solution->offsets[buffer_idx]
+                                 : offset.value_or(BinaryView::kNoValue));
+  }
+  append_column([](const Buffer& b) {
+    return b.hint.value_or(BinaryView::kNoValue);
+  });
+  int64_t id_offset = 0, gap_offset = 0;
+  AppendInt64(output, 0);
+  for (const Buffer& buffer : buffers) {
+    AppendInt64(output, id_offset += buffer.id.size());
+  }
+  for (const Buffer& buffer : buffers) output.append(buffer.id);
+  output.resize(output.size() + PadToWord(id_bytes) - id_bytes, '\0');
+  AppendInt64(output, 0);
+  for (const Buffer& buffer : buffers) {
+    AppendInt64(output, gap_offset += buffer.gaps.size());
+  }
+  const auto append_gaps = [&](auto get) {
+    for (const Buffer& buffer : buffers) {
+      for (const Gap& gap : buffer.gaps) AppendInt64(output, get(gap));
+    }
+  };
+  append_gaps([](const Gap& gap) { return gap.lifespan.lower(); });
+  append_gaps([](const Gap& gap) { return gap.lifespan.upper(); });
+  append_gaps([](const Gap& gap) {
+    return gap.window ? gap.window->lower() : BinaryView::kNoValue;
+  });
+  append_gaps([](const Gap& gap) {
+    return gap.window ? gap.window->upper() : BinaryView::kNoValue;
+  });
+  return output;
+}
+
+absl::StatusOr<BinaryView> BinaryView::Create(absl::string_view input) {
+  if constexpr (std::endian::native != std::endian::little) {
+    return absl::UnimplementedError("Binary views require little-endian hosts");
+  }
+  if (reinterpret_cast<uintptr_t>(input.data()) % alignof(int64_t) != 0) {
+    return absl::InvalidArgumentError("Binary input is misaligned");
+  }
+  BinaryHeader header;
+  if (input.size() < sizeof(header)) {
+    return absl::InvalidArgumentError("Binary input is truncated");
+  }
+  memcpy(&header, input.data(), sizeof(header));
+  if (memcmp(header.magic, kBinaryMagic, sizeof(kBinaryMagic)) != 0) {
+    return absl::InvalidArgumentError("Binary input has an unknown format");
+  }
+  if (header.version != kBinaryVersion) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unsupported binary version: ", header.version));
+  }
+  const int64_t n = header.num_buffers, g = header.num_gaps;
+  const int64_t max_words = input.size() / sizeof(int64_t);
+  if (n < 0 || g < 0 || header.id_bytes < 0 || n > max_words ||
+      g > max_words || header.id_bytes > input.size()) {
+    return absl::InvalidArgumentError("Binary input has invalid counts");
+  }
+  const int64_t expected_size = sizeof(header) + PadToWord(header.id_bytes) +
+                                sizeof(int64_t) * (8 * n + 2 + 4 * g);
+  if (input.size() != expected_size) {
+    return absl::InvalidArgumentError("Binary input has an invalid size");
+  }
+  BinaryView view;
+  view.capacity_ = header.capacity;
+  const char* pos = input.data() + sizeof(header);
+  const auto next_column = [&pos](int64_t length) {
+    std::span<const int64_t> column(
+        reinterpret_cast<const int64_t*>(pos), length);
+    pos += sizeof(int64_t) * length;
+    return column;
+  };
+  view.lowers_ = next_column(n);
+  view.uppers_ = next_column(n);
+  view.sizes_ = next_column(n);
+  view.alignments_ = next_column(n);
+  view.offsets_ = next_column(n);
+  view.hints_ = next_column(n);
+  view.id_offsets_ = next_column(n + 1);
+  view.ids_ = absl::string_view(pos, header.id_bytes);
+  pos += PadToWord(header.id_bytes);
+  view.gap_offsets_ = next_column(n + 1);
+  view.gap_lowers_ = next_column(g);
+  view.gap_uppers_ = next_column(g);
+  view.window_lowers_ = next_column(g);
+  view.window_uppers_ = next_column(g);
+  // Check the offsets into the id table & gap columns (so accessors are safe).
+  const auto valid_offsets = [](std::span<const int64_t> offsets, int64_t max) {
+    if (offsets.front() != 0 || offsets.back() != max) return false;
+    for (size_t idx = 1; idx < offsets.size(); ++idx) {
+      if (offsets[idx] < offsets[idx - 1]) return false;
+    }
+    return true;
+  };
+  if (!valid_offsets(view.id_offsets_, header.id_bytes) ||
+      !valid_offsets(view.gap_offsets_, g)) {
+    return absl::InvalidArgumentError("Binary input has invalid offsets");
+  }
+  return view;
+}
+
+absl::string_view BinaryView::id(BufferIdx buffer_idx) const {
+  const int64_t id_offset = id_offsets_[buffer_idx];
+  return ids_.substr(id_offset, id_offsets_[buffer_idx + 1] - id_offset);
+}
+
+Problem BinaryView::ToProblem() const {
+  Problem problem = {.capacity = capacity_};
+  problem.buffers.resize(num_buffers());
+  for (BufferIdx buffer_idx = 0; buffer_idx < num_buffers(); ++buffer_idx) {
+    Buffer& buffer = problem.buffers[buffer_idx];
+    buffer.id = std::string(id(buffer_idx));
+    buffer.lifespan = {lowers_[buffer_idx], uppers_[buffer_idx]};
+    buffer.size = sizes_[buffer_idx];
+    buffer.alignment = alignments_[buffer_idx];
+    if (offsets_[buffer_idx] != kNoValue) buffer.offset = offsets_[buffer_idx];
+    if (hints_[buffer_idx] != kNoValue) buffer.hint = hints_[buffer_idx];
+    const Interval<int64_t> range = gap_range(buffer_idx);
+    buffer.gaps.reserve(range.upper() - range.lower());
+    for (int64_t gap_idx = range.lower(); gap_idx < range.upper(); ++gap_idx) {
+      Gap& gap = buffer.gaps.emplace_back();
+      gap.lifespan = {gap_lowers_[gap_idx], gap_uppers_[gap_idx]};
+      if (window_lowers_[gap_idx] != kNoValue) {
+        gap.window = {window_lowers_[gap_idx], window_uppers_[gap_idx]};
       }
-      offset = offset_val;
     }
-    problem.buffers.push_back({.id = id,
-                               .lifespan = {lower, upper + addend},
-                               .size = size,
-                               .alignment = alignment,
-                               .gaps = gaps,
-                               .offset = offset,
-                               .hint = hint});
   }
   return problem;
 }
 
+absl::StatusOr<Problem> FromBinary(absl::string_view input) {
+  // Copy any misaligned input into word-aligned storage before viewing it.
+  std::vector<int64_t> aligned;
+  if (reinterpret_cast<uintptr_t>(input.data()) % alignof(int64_t) != 0) {
+    aligned.resize((input.size() + sizeof(int64_t) - 1) / sizeof(int64_t));
+    memcpy(aligned.data(), input.data(), input.size());
+    input = absl::string_view(reinterpret_cast<const char*>(aligned.data()),
+                              input.size());
+  }
+  absl::StatusOr<BinaryView> view = BinaryView::Create(input);
+  if (!view.ok()) return view.status();
+  return view->ToProblem();
+}
+
+absl::StatusOr<Problem> FromBinaryFile(const std::string& path) {
+  absl::StatusOr<MappedFile> mapped_file = MappedFile::Open(path);
+  if (!mapped_file.ok()) return mapped_file.status();
+  return FromBinary(mapped_file->contents());
+}
+
 }  // namespace minimalloc
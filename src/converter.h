@@ -17,9 +17,13 @@ limitations under the License.
 #ifndef MINIMALLOC_SRC_CONVERTER_H_
 #define MINIMALLOC_SRC_CONVERTER_H_
 
+#include <cstdint>
+#include <ostream>
+#include <span>
 #include <string>
 
 #include "minimalloc.h"
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 
@@ -37,6 +41,16 @@ std::string ToCsv(const Problem& problem,
                   Solution* solution = nullptr,
                   bool old_format = false);
 
+// Writes the same CSV as ToCsv directly to a stream or file descriptor.  Values
+// are formatted into a fixed-size buffer that is flushed whenever it fills, so
+// peak memory usage does not depend upon the size of the problem.
+absl::Status WriteCsv(const Problem& problem, std::ostream& os,
+                      const Solution* solution = nullptr,
+                      bool old_format = false);
+absl::Status WriteCsv(const Problem& problem, int fd,
+                      const Solution* solution = nullptr,
+                      bool old_format = false);
+
 // Given a CSV like the one below (with buffers listed in any order), converts
 // it into a Problem instance or returns a status if the problem is malformed:
 //
@@ -49,6 +63,79 @@ std::string ToCsv(const Problem& problem,
 // each buffer's offset or hint member field (respectively).
 absl::StatusOr<Problem> FromCsv(absl::string_view input);
 
+// As above, but splits the records into chunks (at newline boundaries) that are
+// parsed by a pool of threads and then concatenated in their original order.
+// Columns are detected and errors are reported exactly as they are by FromCsv.
+absl::StatusOr<Problem> FromCsv(absl::string_view input, int num_threads);
+
+// Memory-maps the file at the given path, and parses its contents in place
+// using FromCsv (with the given number of threads).
+absl::StatusOr<Problem> FromCsvFile(const std::string& path,
+                                    int num_threads = 1);
+
+// Converts a Problem, along with an optional Solution, into a versioned binary
+// format.  All values are little-endian and stored as 8-byte aligned columns:
+//
+//      header   magic, version, flags, buffer / gap / id byte counts, capacity
+//      buffers  lower[n], upper[n], size[n], alignment[n], offset[n], hint[n]
+//      ids      id_offsets[n + 1], followed by a table of concatenated ids
+//      gaps     gap_offsets[n + 1], gap lower[g], upper[g], window lower[g] and
+//               window upper[g]
+//
+// Absent offsets, hints and windows are stored as kNoValue.  If a solution is
+// provided, its offsets are stored in place of any fixed offsets.
+std::string ToBinary(const Problem& problem, const Solution* solution = nullptr);
+
+// A zero-copy view over a problem in the binary format above (eg, the contents
+// of a MappedFile).  Creating the view checks the header and the bounds of its
+// columns, but otherwise performs no parsing; the viewed memory must outlive it
+// and be 8-byte aligned.
+class BinaryView {
+ public:
+  static constexpr int64_t kNoValue = INT64_MIN;
+
+  static absl::StatusOr<BinaryView> Create(absl::string_view input);
+
+  int64_t num_buffers() const { return lowers_.size(); }
+  Capacity capacity() const { return capacity_; }
+  std::span<const int64_t> lowers() const { return lowers_; }
+  std::span<const int64_t> uppers() const { return uppers_; }
+  std::span<const int64_t> sizes() const { return sizes_; }
+  std::span<const int64_t> alignments() const { return alignments_; }
+  std::span<const int64_t> offsets() const { return offsets_; }
+  std::span<const int64_t> hints() const { return hints_; }
+  absl::string_view id(BufferIdx buffer_idx) const;
+
+  // Returns the (half-open) range of gap indices belonging to a buffer.
+  Interval<int64_t> gap_range(BufferIdx buffer_idx) const {
+    return {gap_offsets_[buffer_idx], gap_offsets_[buffer_idx + 1]};
+  }
+  std::span<const int64_t> gap_lowers() const { return gap_lowers_; }
+  std::span<const int64_t> gap_uppers() const { return gap_uppers_; }
+  std::span<const int64_t> window_lowers() const { return window_lowers_; }
+  std::span<const int64_t> window_uppers() const { return window_uppers_; }
+
+  // Copies the viewed problem into a Problem instance.
+  Problem ToProblem() const;
+
+ private:
+  Capacity capacity_ = 0;
+  std::span<const int64_t> lowers_, uppers_, sizes_, alignments_;
+  std::span<const int64_t> offsets_, hints_;
+  std::span<const int64_t> id_offsets_;
+  absl::string_view ids_;
+  std::span<const int64_t> gap_offsets_;
+  std::span<const int64_t> gap_lowers_, gap_uppers_;
+  std::span<const int64_t> window_lowers_, window_uppers_;
+};
+
+// Converts the binary format into a Problem instance, or returns a status if
+// the input is malformed.  Offsets & hints are stored as they are by FromCsv.
+absl::StatusOr<Problem> FromBinary(absl::string_view input);
+
+// Memory-maps the file at the given path, and converts it using FromBinary.
+absl::StatusOr<Problem> FromBinaryFile(const std::string& path);
+
 }  // namespace minimalloc
 
 #endif  // MINIMALLOC_SRC_CONVERTER_H_
@@ -0,0 +1,222 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "minimalloc.h"
+
+namespace minimalloc {
+namespace {
+
+// A small splitmix64 generator.  Unlike the distributions in <random>, whose
+// output varies between standard libraries, its sequence is fully specified.
+class Random {
+ public:
+  explicit Random(uint64_t seed) : state_(seed) {}
+
+  uint64_t Next() {
+    uint64_t z = (state_ += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+  }
+
+  // Returns a value drawn uniformly from [0, 1).
+  double Uniform() { return (Next() >> 11) * 0x1.0p-53; }
+
+  // Returns a value drawn uniformly from [0, n).
+  int64_t Below(int64_t n) { return Next() % n; }
+
+  // Returns a value from [min, max], increasingly biased toward min as the
+  // skew grows.
+  int64_t Skewed(int64_t min, int64_t max, double skew) {
+    double u = Uniform();
+    if (skew > 0) u = std::pow(u, 1.0 + skew);
+    return min + std::min<int64_t>(u * (max - min + 1), max - min);
+  }
+
+ private:
+  uint64_t state_;
+};
+
+absl::Status CheckParams(const GeneratorParams& params) {
+  if (params.num_buffers < 0) {
+    return absl::InvalidArgumentError("Number of buffers is negative");
+  }
+  if (params.num_partitions < 1) {
+    return absl::InvalidArgumentError("Number of partitions must be positive");
+  }
+  if (params.min_length < 1 || params.max_length < params.min_length) {
+    return absl::InvalidArgumentError("Invalid range of lifespan lengths");
+  }
+  if (params.horizon != 0 && params.horizon < params.max_length) {
+    return absl::InvalidArgumentError("Horizon is shorter than max length");
+  }
+  if (params.min_size < 1 || params.max_size < params.min_size) {
+    return absl::InvalidArgumentError("Invalid range of buffer sizes");
+  }
+  if (params.length_skew < 0 || params.size_skew < 0) {
+    return absl::InvalidArgumentError("Skew is negative");
+  }
+  double total_weight = 0;
+  for (const AlignmentWeight& alignment_weight : params.alignments) {
+    if (alignment_weight.alignment < 1 || alignment_weight.weight < 0) {
+      return absl::InvalidArgumentError("Invalid alignment or weight");
+    }
+    total_weight += alignment_weight.weight;
+  }
+  if (total_weight <= 0) {
+    return absl::InvalidArgumentError("No alignments with positive weight");
+  }
+  if (params.gap_density < 0) {
+    return absl::InvalidArgumentError("Gap density is negative");
+  }
+  if (params.window_probability < 0 || params.window_probability > 1) {
+    return absl::InvalidArgumentError("Window probability is out of range");
+  }
+  if (params.tightness <= 0 || params.tightness > 1) {
+    return absl::InvalidArgumentError("Tightness is out of range");
+  }
+  return absl::OkStatus();
+}
+
+int64_t PickAlignment(const std::vector<AlignmentWeight>& alignments,
+                      double total_weight, Random& random) {
+  double u = random.Uniform() * total_weight;
+  for (const AlignmentWeight& alignment_weight : alignments) {
+    if (u < alignment_weight.weight) return alignment_weight.alignment;
+    u -= alignment_weight.weight;
+  }
+  return alignments.back().alignment;
+}
+
+// Carves the lifespan into equal slots, and places a gap in the interior of
+// each (so that no two gaps touch, nor either end of the lifespan).
+std::vector<Gap> CreateGaps(const Buffer& buffer, int64_t num_gaps,
+                            double window_probability, Random& random) {
+  const TimeValue length = buffer.lifespan.upper() - buffer.lifespan.lower();
+  num_gaps = std::min(num_gaps, length / 3);
+  std::vector<Gap> gaps;
+  gaps.reserve(num_gaps);
+  for (int64_t gap_idx = 0; gap_idx < num_gaps; ++gap_idx) {
+    const TimeValue slot_lower =
+        buffer.lifespan.lower() + length * gap_idx / num_gaps;
+    const TimeValue slot_upper =
+        buffer.lifespan.lower() + length * (gap_idx + 1) / num_gaps;
+    const TimeValue lower = slot_lower + 1 + random.Below(slot_upper -
+                                                          slot_lower - 2);
+    const TimeValue upper = lower + 1 + random.Below(slot_upper - lower - 1);
+    Gap gap = {.lifespan = {lower, upper}};
+    if (random.Uniform() < window_probability) {
+      const Offset window_lower = random.Below(buffer.size);
+      gap.window = {window_lower,
+                    window_lower + 1 + random.Below(buffer.size - window_lower)};
+    }
+    gaps.push_back(gap);
+  }
+  return gaps;
+}
+
+int64_t PeakTotal(std::span<const Buffer> buffers) {
+  std::vector<std::pair<TimeValue, int64_t>> deltas;
+  deltas.reserve(buffers.size() * 2);
+  for (const Buffer& buffer : buffers) {
+    deltas.push_back({buffer.lifespan.lower(), buffer.size});
+    deltas.push_back({buffer.lifespan.upper(), -buffer.size});
+    for (const Gap& gap : buffer.gaps) {
+      const int64_t window_size =
+          gap.window ? gap.window->upper() - gap.window->lower() : 0;
+      deltas.push_back({gap.lifespan.lower(), window_size - buffer.size});
+      deltas.push_back({gap.lifespan.upper(), buffer.size - window_size});
+    }
+  }
+  std::sort(deltas.begin(), deltas.end());
+  int64_t total = 0, peak = 0;
+  for (const auto& [time_value, delta] : deltas) {
+    total += delta;
+    peak = std::max(peak, total);
+  }
+  return peak;
+}
+
+}  // namespace
+
+absl::StatusOr<Problem> Generate(const GeneratorParams& params) {
+  if (absl::Status status = CheckParams(params); !status.ok()) return status;
+  double total_weight = 0;
+  for (const AlignmentWeight& alignment_weight : params.alignments) {
+    total_weight += alignment_weight.weight;
+  }
+  const int64_t buffers_per_partition =
+      (params.num_buffers + params.num_partitions - 1) / params.num_partitions;
+  const TimeValue horizon = params.horizon ? params.horizon
+      : std::max(params.max_length, buffers_per_partition);
+  const int64_t whole_gaps = params.gap_density;
+  const double partial_gaps = params.gap_density - whole_gaps;
+  Random random(params.seed);
+  Problem problem;
+  problem.buffers.reserve(params.num_buffers);
+  int64_t lower_bound = 0;
+  for (int64_t partition_idx = 0; partition_idx < params.num_partitions;
+       ++partition_idx) {
+    // Leave a unit of time between partitions so they never touch.
+    const TimeValue base = partition_idx * (horizon + 1);
+    const int64_t partition_begin = problem.buffers.size();
+    const int64_t partition_end = std::min(
+        params.num_buffers, partition_begin + buffers_per_partition);
+    for (BufferIdx buffer_idx = partition_begin; buffer_idx < partition_end;
+         ++buffer_idx) {
+      const TimeValue length =
+          random.Skewed(params.min_length, params.max_length,
+                        params.length_skew);
+      const TimeValue lower = base + random.Below(horizon - length + 1);
+      Buffer buffer = {
+          .id = std::to_string(buffer_idx),
+          .lifespan = {lower, lower + length},
+          .size = random.Skewed(params.min_size, params.max_size,
+                                params.size_skew),
+          .alignment = PickAlignment(params.alignments, total_weight, random)};
+      const int64_t num_gaps =
+          whole_gaps + (random.Uniform() < partial_gaps ? 1 : 0);
+      if (num_gaps > 0) {
+        buffer.gaps = CreateGaps(buffer, num_gaps, params.window_probability,
+                                 random);
+      }
+      problem.buffers.push_back(std::move(buffer));
+    }
+    const std::span<const Buffer> partition(
+        problem.buffers.begin() + partition_begin, problem.buffers.end());
+    lower_bound = std::max(lower_bound, PeakTotal(partition));
+  }
+  problem.capacity = std::ceil(lower_bound / params.tightness);
+  return problem;
+}
+
+int64_t ComputeLowerBound(const Problem& problem) {
+  return PeakTotal(problem.buffers);
+}
+
+}  // namespace minimalloc
@@ -0,0 +1,72 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef MINIMALLOC_SRC_GENERATOR_H_
+#define MINIMALLOC_SRC_GENERATOR_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "minimalloc.h"
+
+namespace minimalloc {
+
+struct AlignmentWeight {
+  int64_t alignment = 1;
+  double weight = 1.0;  // The relative likelihood of this alignment.
+};
+
+// Describes a family of synthetic problems.  Lengths and sizes are drawn from
+// [min, max] with a skew of zero being uniform, and larger skews favoring ever
+// smaller values.
+struct GeneratorParams {
+  int64_t num_buffers = 1000;
+  // Time is split into this many disjoint ranges (buffers never span two), so
+  // the resulting problem has at least as many partitions.
+  int64_t num_partitions = 1;
+  // The length of time covered by each partition, or zero to use the number
+  // of buffers per partition (so that roughly as many buffers are live at any
+  // moment as the average lifespan length).
+  TimeValue horizon = 0;
+  TimeValue min_length = 1;
+  TimeValue max_length = 100;
+  double length_skew = 0.0;
+  int64_t min_size = 1;
+  int64_t max_size = 1024;
+  double size_skew = 0.0;
+  std::vector<AlignmentWeight> alignments = {{.alignment = 1}};
+  // The expected number of gaps per buffer, and the likelihood that each one
+  // retains a window of memory.
+  double gap_density = 0.0;
+  double window_probability = 0.5;
+  // The ratio of the lower bound (ie, the maximum total size of the buffers
+  // active at any moment) to the capacity, where 1.0 is as tight as possible.
+  double tightness = 1.0;
+  uint64_t seed = 0;
+};
+
+// Generates a problem from the given parameters.  Identical parameters (and
+// seed) always produce an identical problem.
+absl::StatusOr<Problem> Generate(const GeneratorParams& params);
+
+// Returns the maximum total size of the buffer windows active at any moment,
+// which no feasible solution's capacity may fall below.
+int64_t ComputeLowerBound(const Problem& problem);
+
+}  // namespace minimalloc
+
+#endif  // MINIMALLOC_SRC_GENERATOR_H_
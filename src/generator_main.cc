@@ -0,0 +1,122 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cstdint>
+#include <fstream>
+#include <ios>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "converter.h"
+#include "generator.h"
+#include "minimalloc.h"
+
+ABSL_FLAG(std::string, output, "", "The path to the output file.");
+ABSL_FLAG(std::string, output_format, "csv",
+          "The format of the output file (either 'csv' or 'binary').");
+ABSL_FLAG(int64_t, num_buffers, 1000, "The number of buffers.");
+ABSL_FLAG(int64_t, num_partitions, 1, "The number of disjoint time ranges.");
+ABSL_FLAG(int64_t, horizon, 0,
+          "The length of time covered by each partition (0 for automatic).");
+ABSL_FLAG(int64_t, min_length, 1, "The minimum lifespan length.");
+ABSL_FLAG(int64_t, max_length, 100, "The maximum lifespan length.");
+ABSL_FLAG(double, length_skew, 0.0, "The bias toward shorter lifespans.");
+ABSL_FLAG(int64_t, min_size, 1, "The minimum buffer size.");
+ABSL_FLAG(int64_t, max_size, 1024, "The maximum buffer size.");
+ABSL_FLAG(double, size_skew, 0.0, "The bias toward smaller buffers.");
+ABSL_FLAG(std::string, alignments, "1",
+          "A list of alignments w/ optional weights, eg. '1:0.5,8:0.3,64:0.2'.");
+ABSL_FLAG(double, gap_density, 0.0, "The expected number of gaps per buffer.");
+ABSL_FLAG(double, window_probability, 0.5,
+          "The likelihood that a gap retains a window of memory.");
+ABSL_FLAG(double, tightness, 1.0,
+          "The ratio of the lower bound to capacity, in (0, 1].");
+ABSL_FLAG(uint64_t, seed, 0, "The random seed.");
+
+namespace {
+
+absl::StatusOr<std::vector<minimalloc::AlignmentWeight>> ParseAlignments(
+    absl::string_view input) {
+  std::vector<minimalloc::AlignmentWeight> alignments;
+  for (absl::string_view entry : absl::StrSplit(input, ',', absl::SkipEmpty())) {
+    std::pair<absl::string_view, absl::string_view> parts =
+        absl::StrSplit(entry, absl::MaxSplits(':', 1));
+    minimalloc::AlignmentWeight alignment_weight;
+    if (!absl::SimpleAtoi(parts.first, &alignment_weight.alignment) ||
+        (!parts.second.empty() &&
+         !absl::SimpleAtod(parts.second, &alignment_weight.weight))) {
+      return absl::InvalidArgumentError("Improperly formed alignments");
+    }
+    alignments.push_back(alignment_weight);
+  }
+  return alignments;
+}
+
+}  // namespace
+
+// Generates a synthetic problem, and writes it to a file.
+int main(int argc, char* argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  absl::StatusOr<std::vector<minimalloc::AlignmentWeight>> alignments =
+      ParseAlignments(absl::GetFlag(FLAGS_alignments));
+  if (!alignments.ok()) {
+    std::cerr << alignments.status() << std::endl;
+    return 1;
+  }
+  const minimalloc::GeneratorParams params = {
+      .num_buffers = absl::GetFlag(FLAGS_num_buffers),
+      .num_partitions = absl::GetFlag(FLAGS_num_partitions),
+      .horizon = absl::GetFlag(FLAGS_horizon),
+      .min_length = absl::GetFlag(FLAGS_min_length),
+      .max_length = absl::GetFlag(FLAGS_max_length),
+      .length_skew = absl::GetFlag(FLAGS_length_skew),
+      .min_size = absl::GetFlag(FLAGS_min_size),
+      .max_size = absl::GetFlag(FLAGS_max_size),
+      .size_skew = absl::GetFlag(FLAGS_size_skew),
+      .alignments = *std::move(alignments),
+      .gap_density = absl::GetFlag(FLAGS_gap_density),
+      .window_probability = absl::GetFlag(FLAGS_window_probability),
+      .tightness = absl::GetFlag(FLAGS_tightness),
+      .seed = absl::GetFlag(FLAGS_seed),
+  };
+  const std::string output_format = absl::GetFlag(FLAGS_output_format);
+  if (output_format != "csv" && output_format != "binary") {
+    std::cerr << "Unknown format (expected 'csv' or 'binary')" << std::endl;
+    return 1;
+  }
+  absl::StatusOr<minimalloc::Problem> problem = minimalloc::Generate(params);
+  if (!problem.ok()) {
+    std::cerr << problem.status() << std::endl;
+    return 1;
+  }
+  std::cerr << "capacity=" << problem->capacity << std::endl;
+  std::ofstream ofs(absl::GetFlag(FLAGS_output), std::ios::binary);
+  if (output_format == "binary") {
+    ofs << minimalloc::ToBinary(*problem);
+  } else if (!minimalloc::WriteCsv(*problem, ofs).ok()) {
+    return 1;
+  }
+  ofs.close();
+  return ofs.fail() ? 1 : 0;
+}
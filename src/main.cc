@@ -17,32 +17,68 @@ limitations under the License.
 #include <algorithm>
 #include <climits>
 #include <cstdint>
+#include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <ios>
 #include <iostream>
-#include <iterator>
+#include <memory>
+#include <optional>
 #include <ostream>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/blocking_counter.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
+#include "batch_solver.h"
 #include "converter.h"
 #include "minimalloc.h"
+#include "server.h"
+#include "solution_cache.h"
 #include "solver.h"
+#include "thread_pool.h"
 #include "validator.h"
 
-ABSL_FLAG(int64_t, capacity, 0, "The maximum memory capacity.");
-ABSL_FLAG(std::string, input, "", "The path to the input CSV file.");
-ABSL_FLAG(std::string, output, "", "The path to the output CSV file.");
+ABSL_FLAG(std::optional<int64_t>, capacity, std::nullopt,
+          "The maximum memory capacity (which, if given, overrides that of a "
+          "binary input).");
+ABSL_FLAG(std::string, input, "", "The path to the input file.");
+ABSL_FLAG(std::string, output, "", "The path to the output file.");
+ABSL_FLAG(std::string, input_format, "csv",
+          "The format of the input file (either 'csv' or 'binary').");
+ABSL_FLAG(std::string, output_format, "csv",
+          "The format of the output file (either 'csv' or 'binary').");
+ABSL_FLAG(int, parse_threads, 1,
+          "The number of threads used to parse a CSV input file.");
+ABSL_FLAG(std::string, input_dir, "",
+          "A directory of input files to solve as a batch (instead of --input).");
+ABSL_FLAG(std::string, manifest, "",
+          "A file listing inputs to solve as a batch, one 'path[,capacity]' per "
+          "line (instead of --input).");
+ABSL_FLAG(std::string, output_dir, "",
+          "The directory in which to write each batch solution.");
+ABSL_FLAG(int, batch_threads, 0,
+          "The number of problems solved at once (or zero for one per core).");
+ABSL_FLAG(std::string, serve, "",
+          "Runs as a daemon that solves requests over a Unix domain socket at "
+          "this path (see server.h), using --batch_threads workers.");
+ABSL_FLAG(std::string, cache_dir, "",
+          "A directory of previously found solutions (to problems and to their "
+          "larger partitions) to consult and update while solving.");
 ABSL_FLAG(absl::Duration, timeout, absl::InfiniteDuration(),
           "The time limit enforced for the MiniMalloc solver.");
 ABSL_FLAG(bool, validate, false, "Validates the solver's output.");
+ABSL_FLAG(int, validate_threads, 1,
+          "The number of threads used to report validation failures.");
 
 ABSL_FLAG(bool, canonical_only, true, "Explores canonical solutions only.");
 ABSL_FLAG(bool, section_inference, true, "Performs advanced inference.");
@@ -57,6 +93,16 @@ ABSL_FLAG(bool, monotonic_floor, true,
           "Requires the solution floor to increase monotonically.");
 ABSL_FLAG(bool, hatless_pruning, true,
           "Prunes alternate solutions whenever a buffer has nothing overhead.");
+ABSL_FLAG(bool, deduplicate_partitions, true,
+          "Solves partitions that are identical up to a shift in time once.");
+ABSL_FLAG(bool, break_symmetries, true,
+          "Places interchangeable buffers in a fixed relative order.");
+ABSL_FLAG(bool, normalize_scale, true,
+          "Divides sizes & offsets by their greatest common divisor.");
+ABSL_FLAG(bool, small_partition_search, true,
+          "Solves partitions of a few buffers with a dedicated search.");
+ABSL_FLAG(bool, dense_overlaps, false,
+          "Tracks the overlaps of dense partitions as bitsets.");
 
 ABSL_FLAG(std::string, preordering_heuristics, "WAT,TAW,TWA",
           "Static preordering heuristics to attempt.");
@@ -67,6 +113,33 @@ ABSL_FLAG(bool, print_solution, false, "Prints the solution in LaTeX");
 const float kWidth = 17;
 const float kHeight = 8.5;
 
+// Lists every violation found in a solution that failed validation.
+void PrintViolations(const minimalloc::Problem& problem,
+                     const minimalloc::Solution& solution) {
+  const minimalloc::ValidationReport report = minimalloc::ValidateAll(
+      problem, solution, absl::GetFlag(FLAGS_validate_threads));
+  for (const minimalloc::Violation& violation : report.violations) {
+    const std::string& id = problem.buffers[violation.buffer_idx].id;
+    switch (violation.kind) {
+      case minimalloc::kBadFixed:
+        std::cerr << "Buffer " << id << " is not at its fixed offset";
+        break;
+      case minimalloc::kBadOffset:
+        std::cerr << "Buffer " << id << " is out of bounds";
+        break;
+      case minimalloc::kBadAlignment:
+        std::cerr << "Buffer " << id << " is misaligned";
+        break;
+      default:
+        std::cerr << "Buffers " << id << " and "
+            << problem.buffers[*violation.other_idx].id << " overlap from "
+            << violation.lifespan->lower() << " to "
+            << violation.lifespan->upper();
+    }
+    std::cerr << std::endl;
+  }
+}
+
 void PrintSolution(const minimalloc::Problem& problem,
                    const minimalloc::Solution& solution) {
   std::ostream& os = std::cout;
@@ -114,6 +187,127 @@ void PrintSolution(const minimalloc::Problem& problem,
   os << "\\end{document}" << std::endl;
 }
 
+// Writes the solution to a file in the given format.
+bool WriteOutput(const std::string& path, const std::string& output_format,
+                 const minimalloc::Problem& problem,
+                 const minimalloc::Solution& solution) {
+  std::ofstream ofs(path, std::ios::binary);
+  if (output_format == "binary") {
+    ofs << minimalloc::ToBinary(problem, &solution);
+  } else if (!minimalloc::WriteCsv(problem, ofs, &solution).ok()) {
+    return false;
+  }
+  ofs.close();
+  return ofs.good();
+}
+
+absl::StatusOr<minimalloc::Problem> ReadInput(const std::string& path,
+                                              const std::string& input_format,
+                                              int num_threads) {
+  return input_format == "binary" ? minimalloc::FromBinaryFile(path)
+                                  : minimalloc::FromCsvFile(path, num_threads);
+}
+
+// Solves every input of a directory or manifest on a pool of threads, printing
+// one line per input (as each completes) with its status and solve time.
+int RunBatch(const minimalloc::SolverParams& params,
+             const std::string& input_format,
+             const std::string& output_format,
+             const minimalloc::SolutionCache* cache) {
+  const std::optional<int64_t> capacity = absl::GetFlag(FLAGS_capacity);
+  const absl::StatusOr<std::vector<minimalloc::BatchInput>> inputs =
+      absl::GetFlag(FLAGS_manifest).empty()
+          ? minimalloc::ListBatchInputs(absl::GetFlag(FLAGS_input_dir),
+                                        capacity)
+          : minimalloc::ReadBatchManifest(absl::GetFlag(FLAGS_manifest),
+                                          capacity);
+  if (!inputs.ok()) {
+    std::cerr << inputs.status() << std::endl;
+    return 1;
+  }
+  // Each solution is named after its input, so no two inputs may share a name.
+  const std::string output_dir = absl::GetFlag(FLAGS_output_dir);
+  std::vector<std::string> output_paths;
+  if (!output_dir.empty()) {
+    absl::flat_hash_map<std::string, std::string> output_inputs;
+    for (const minimalloc::BatchInput& input : *inputs) {
+      output_paths.push_back((std::filesystem::path(output_dir) /
+          std::filesystem::path(input.path).filename()).string());
+      const auto [it, inserted] =
+          output_inputs.try_emplace(output_paths.back(), input.path);
+      if (!inserted) {
+        std::cerr << "Inputs " << it->second << " and " << input.path
+                  << " would both be written to " << it->first << std::endl;
+        return 1;
+      }
+    }
+  }
+  int num_threads = absl::GetFlag(FLAGS_batch_threads);
+  if (num_threads <= 0) num_threads = std::thread::hardware_concurrency();
+  // Parse every input in parallel, setting aside any that fail.
+  std::vector<absl::StatusOr<minimalloc::Problem>> parsed(inputs->size());
+  {
+    minimalloc::ThreadPool thread_pool(num_threads);
+    absl::BlockingCounter counter(inputs->size());
+    for (int input_idx = 0; input_idx < inputs->size(); ++input_idx) {
+      thread_pool.Schedule([&, input_idx]() {
+        parsed[input_idx] = ReadInput((*inputs)[input_idx].path, input_format,
+                                      /*num_threads=*/1);
+        if (parsed[input_idx].ok() && (*inputs)[input_idx].capacity) {
+          parsed[input_idx]->capacity = *(*inputs)[input_idx].capacity;
+        }
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+  bool success = true;
+  std::vector<int> input_idxs;
+  std::vector<minimalloc::Problem> problems;
+  for (int input_idx = 0; input_idx < inputs->size(); ++input_idx) {
+    if (!parsed[input_idx].ok()) {
+      std::cout << (*inputs)[input_idx].path << "\t"
+                << parsed[input_idx].status() << std::endl;
+      success = false;
+      continue;
+    }
+    input_idxs.push_back(input_idx);
+    problems.push_back(*std::move(parsed[input_idx]));
+  }
+  const minimalloc::Solver solver(params, cache);
+  minimalloc::SolveBatch(solver, problems, num_threads,
+      [&](minimalloc::BatchResult result) {
+        const int input_idx = input_idxs[result.problem_idx];
+        const std::string& path = (*inputs)[input_idx].path;
+        const minimalloc::Problem& problem = problems[result.problem_idx];
+        const absl::Duration elapsed = result.stats.sweep_time +
+            result.stats.setup_time + result.stats.search_time;
+        std::cout << path << "\t" << std::fixed << std::setprecision(3)
+                  << absl::ToDoubleSeconds(elapsed) << "\t";
+        if (!result.solution.ok()) {
+          std::cout << result.solution.status() << std::endl;
+          success = false;
+          return;
+        }
+        std::cout << "OK";
+        if (absl::GetFlag(FLAGS_validate)) {
+          const bool good = minimalloc::Validate(problem, *result.solution) ==
+              minimalloc::ValidationResult::kGood;
+          std::cout << "\t" << (good ? "PASS" : "FAIL");
+          success &= good;
+        }
+        std::cout << std::endl;
+        if (output_dir.empty()) return;
+        const std::string& output_path = output_paths[input_idx];
+        if (!WriteOutput(output_path, output_format, problem,
+                         *result.solution)) {
+          std::cerr << "Cannot write " << output_path << std::endl;
+          success = false;
+        }
+      }, cache);
+  return success ? 0 : 1;
+}
+
 // Solves a given problem using the Solver.
 int main(int argc, char* argv[]) {
   absl::ParseCommandLine(argc, argv);
@@ -128,18 +322,56 @@ int main(int argc, char* argv[]) {
       .dynamic_decomposition = absl::GetFlag(FLAGS_dynamic_decomposition),
       .monotonic_floor = absl::GetFlag(FLAGS_monotonic_floor),
       .hatless_pruning = absl::GetFlag(FLAGS_hatless_pruning),
+      .deduplicate_partitions = absl::GetFlag(FLAGS_deduplicate_partitions),
+      .break_symmetries = absl::GetFlag(FLAGS_break_symmetries),
+      .normalize_scale = absl::GetFlag(FLAGS_normalize_scale),
+      .small_partition_search = absl::GetFlag(FLAGS_small_partition_search),
+      .dense_overlaps = absl::GetFlag(FLAGS_dense_overlaps),
       .preordering_heuristics = absl::StrSplit(
           absl::GetFlag(FLAGS_preordering_heuristics), ',', absl::SkipEmpty()),
   };
-  std::ifstream ifs(absl::GetFlag(FLAGS_input));
-  std::string csv((std::istreambuf_iterator<char>(ifs)),
-                  (std::istreambuf_iterator<char>()   ));
-  absl::StatusOr<minimalloc::Problem> problem = minimalloc::FromCsv(csv);
+  const std::string input_format = absl::GetFlag(FLAGS_input_format);
+  const std::string output_format = absl::GetFlag(FLAGS_output_format);
+  if ((input_format != "csv" && input_format != "binary") ||
+      (output_format != "csv" && output_format != "binary")) {
+    std::cerr << "Unknown format (expected 'csv' or 'binary')" << std::endl;
+    return 1;
+  }
+  std::optional<minimalloc::SolutionCache> cache;
+  if (!absl::GetFlag(FLAGS_cache_dir).empty()) {
+    cache.emplace(absl::GetFlag(FLAGS_cache_dir));
+  }
+  if (!absl::GetFlag(FLAGS_serve).empty()) {
+    int num_threads = absl::GetFlag(FLAGS_batch_threads);
+    if (num_threads <= 0) num_threads = std::thread::hardware_concurrency();
+    absl::StatusOr<std::unique_ptr<minimalloc::Server>> server =
+        minimalloc::Server::Create(absl::GetFlag(FLAGS_serve), params,
+                                   num_threads, cache ? &*cache : nullptr);
+    if (!server.ok()) {
+      std::cerr << server.status() << std::endl;
+      return 1;
+    }
+    (*server)->Serve();
+    return 0;
+  }
+  if (!absl::GetFlag(FLAGS_input_dir).empty() ||
+      !absl::GetFlag(FLAGS_manifest).empty()) {
+    return RunBatch(params, input_format, output_format,
+                    cache ? &*cache : nullptr);
+  }
+  absl::StatusOr<minimalloc::Problem> problem =
+      ReadInput(absl::GetFlag(FLAGS_input), input_format,
+                absl::GetFlag(FLAGS_parse_threads));
   if (!problem.ok()) return 1;
-  problem->capacity = absl::GetFlag(FLAGS_capacity);
-  minimalloc::Solver solver(params);
+  if (const std::optional<int64_t> capacity = absl::GetFlag(FLAGS_capacity)) {
+    problem->capacity = *capacity;
+  }
+  minimalloc::Solver solver(params, cache ? &*cache : nullptr);
   const absl::Time start_time = absl::Now();
-  absl::StatusOr<minimalloc::Solution> solution = solver.Solve(*problem);
+  minimalloc::SolveContext context;
+  absl::StatusOr<minimalloc::Solution> solution = cache
+      ? minimalloc::SolveWithCache(solver, *cache, *problem, context)
+      : solver.Solve(*problem, context);
   const absl::Time end_time = absl::Now();
   std::cerr << std::fixed << std::setprecision(3)
       << absl::ToDoubleSeconds(end_time - start_time);
@@ -149,11 +381,12 @@ int main(int argc, char* argv[]) {
         minimalloc::Validate(*problem, *solution);
     std::cerr << (validation_result == minimalloc::ValidationResult::kGood
         ? "PASS" : "FAIL") << std::endl;
+    if (validation_result != minimalloc::ValidationResult::kGood) {
+      PrintViolations(*problem, *solution);
+    }
   }
   if (absl::GetFlag(FLAGS_print_solution)) PrintSolution(*problem, *solution);
-  std::string contents = minimalloc::ToCsv(*problem, &(*solution));
-  std::ofstream ofs(absl::GetFlag(FLAGS_output));
-  ofs << contents;
-  ofs.close();
-  return 0;
+  if (absl::GetFlag(FLAGS_output).empty()) return 0;
+  return WriteOutput(absl::GetFlag(FLAGS_output), output_format, *problem,
+                     *solution) ? 0 : 1;
 }
@@ -0,0 +1,72 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+
+namespace minimalloc {
+
+absl::StatusOr<MappedFile> MappedFile::Open(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return absl::NotFoundError(absl::StrCat("Cannot open ", path));
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return absl::InternalError(absl::StrCat("Cannot stat ", path));
+  }
+  const size_t size = st.st_size;
+  if (size == 0) {  // Empty files cannot be mapped, but are valid nonetheless.
+    close(fd);
+    return MappedFile(nullptr, 0);
+  }
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);  // The mapping remains valid after the descriptor is closed.
+  if (data == MAP_FAILED) {
+    return absl::InternalError(absl::StrCat("Cannot map ", path));
+  }
+  madvise(data, size, MADV_SEQUENTIAL);
+  return MappedFile(static_cast<const char*>(data), size);
+}
+
+MappedFile::MappedFile(MappedFile&& x) noexcept
+    : data_(std::exchange(x.data_, nullptr)), size_(std::exchange(x.size_, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& x) noexcept {
+  if (this != &x) {
+    if (data_) munmap(const_cast<char*>(data_), size_);
+    data_ = std::exchange(x.data_, nullptr);
+    size_ = std::exchange(x.size_, 0);
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile() {
+  if (data_) munmap(const_cast<char*>(data_), size_);
+}
+
+}  // namespace minimalloc
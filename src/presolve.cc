@@ -0,0 +1,122 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "presolve.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "minimalloc.h"
+
+namespace minimalloc {
+namespace {
+
+// Determines whether a buffer occupies its full size at some moment, ie, if
+// its gaps don't cover the whole of its lifespan.
+bool HasFullExtent(const Buffer& buffer) {
+  if (buffer.size <= 0) return false;
+  std::vector<Lifespan> gaps;
+  gaps.reserve(buffer.gaps.size());
+  for (const Gap& gap : buffer.gaps) gaps.push_back(gap.lifespan);
+  std::sort(gaps.begin(), gaps.end(), [](const Lifespan& a, const Lifespan& b) {
+    return a.lower() < b.lower();
+  });
+  TimeValue time = buffer.lifespan.lower();
+  for (const Lifespan& gap : gaps) {
+    if (gap.lower() > time) return true;
+    time = std::max(time, gap.upper());
+  }
+  return time < buffer.lifespan.upper();
+}
+
+}  // namespace
+
+std::vector<BufferIdx> FindPreviousEquivalents(const Problem& problem) {
+  constexpr int64_t kNoValue = std::numeric_limits<int64_t>::min();
+  std::vector<BufferIdx> previous(problem.buffers.size(), -1);
+  absl::flat_hash_map<std::vector<int64_t>, BufferIdx> last_in_class;
+  for (BufferIdx buffer_idx = 0; buffer_idx < problem.buffers.size();
+       ++buffer_idx) {
+    const Buffer& buffer = problem.buffers[buffer_idx];
+    // Members of a class must overlap, or else they could be solved in
+    // separate partitions (where their relative order can't be enforced).
+    if (buffer.offset || !HasFullExtent(buffer)) continue;
+    std::vector<int64_t> key = {buffer.lifespan.lower(),
+                                buffer.lifespan.upper(), buffer.size,
+                                buffer.alignment};
+    for (const Gap& gap : buffer.gaps) {
+      key.push_back(gap.lifespan.lower());
+      key.push_back(gap.lifespan.upper());
+      key.push_back(gap.window ? gap.window->lower() : kNoValue);
+      key.push_back(gap.window ? gap.window->upper() : kNoValue);
+    }
+    auto [it, inserted] = last_in_class.try_emplace(std::move(key), buffer_idx);
+    if (!inserted) previous[buffer_idx] = std::exchange(it->second, buffer_idx);
+  }
+  return previous;
+}
+
+int64_t ComputeScale(const Problem& problem) {
+  int64_t scale = 0;
+  for (const Buffer& buffer : problem.buffers) {
+    scale = std::gcd(scale, buffer.size);
+    if (buffer.offset) scale = std::gcd(scale, *buffer.offset);
+    for (const Gap& gap : buffer.gaps) {
+      if (!gap.window) continue;
+      scale = std::gcd(scale, gap.window->lower());
+      scale = std::gcd(scale, gap.window->upper());
+    }
+  }
+  if (scale <= 1) return 1;
+  // Each alignment must either divide the scale (and so be satisfied by every
+  // multiple of it) or be a multiple of it.  Shrinking the scale may break an
+  // alignment that previously divided it, so repeat until nothing changes.
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (const Buffer& buffer : problem.buffers) {
+      if (scale % buffer.alignment == 0 || buffer.alignment % scale == 0) {
+        continue;
+      }
+      scale = std::gcd(scale, buffer.alignment);
+      changed = true;
+    }
+  }
+  return scale;
+}
+
+Problem ScaleDown(const Problem& problem, int64_t scale) {
+  Problem scaled = {.buffers = problem.buffers,
+                    .capacity = problem.capacity / scale};
+  for (Buffer& buffer : scaled.buffers) {
+    buffer.size /= scale;
+    buffer.alignment = buffer.alignment % scale == 0
+        ? buffer.alignment / scale : 1;
+    if (buffer.offset) *buffer.offset /= scale;
+    if (buffer.hint) *buffer.hint /= scale;
+    for (Gap& gap : buffer.gaps) {
+      if (!gap.window) continue;
+      gap.window = {gap.window->lower() / scale, gap.window->upper() / scale};
+    }
+  }
+  return scaled;
+}
+
+}  // namespace minimalloc
@@ -0,0 +1,50 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef MINIMALLOC_SRC_PRESOLVE_H_
+#define MINIMALLOC_SRC_PRESOLVE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "minimalloc.h"
+
+namespace minimalloc {
+
+// Identifies classes of interchangeable buffers: those with identical
+// lifespans, sizes, alignments and gaps (and without fixed offsets), which are
+// guaranteed to overlap one another.  Returns the index of the previous buffer
+// in each buffer's class, or -1 for the first buffer of a class.  Any solution
+// remains a solution after permuting the offsets within a class, so a search
+// may require that each buffer be placed after its predecessor.
+std::vector<BufferIdx> FindPreviousEquivalents(const Problem& problem);
+
+// Returns the greatest common divisor of every size, window bound and fixed
+// offset, reduced further until each alignment either divides it or is a
+// multiple of it (or one if there is no such divisor).  Every offset the solver
+// considers is then a multiple of this scale, so dividing these values by it
+// (and the capacity too, rounding down) yields an equivalent problem with
+// smaller magnitudes.
+int64_t ComputeScale(const Problem& problem);
+
+// Divides a problem's sizes, alignments, windows, fixed offsets, hints and
+// capacity by a scale computed as above (rounding the last two down, and
+// relaxing alignments that divide the scale to one).
+Problem ScaleDown(const Problem& problem, int64_t scale);
+
+}  // namespace minimalloc
+
+#endif  // MINIMALLOC_SRC_PRESOLVE_H_
@@ -0,0 +1,392 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "server.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "converter.h"
+#include "minimalloc.h"
+#include "solution_cache.h"
+#include "solver.h"
+
+namespace minimalloc {
+namespace {
+
+constexpr int64_t kWordSize = 8;
+constexpr int64_t kSolveHeaderWords = 4;  // Type, request id, format, capacity.
+
+void AppendInt64(std::string& output, int64_t value) {
+  const uint64_t bits = value;
+  for (int byte = 0; byte < 8; ++byte) output.push_back(bits >> (8 * byte));
+}
+
+int64_t LoadInt64(absl::string_view input, int64_t word_idx) {
+  uint64_t bits = 0;
+  for (int byte = 7; byte >= 0; --byte) {
+    bits = (bits << 8) |
+        static_cast<uint8_t>(input[word_idx * kWordSize + byte]);
+  }
+  return bits;
+}
+
+int64_t NumWords(absl::string_view input) { return input.size() / kWordSize; }
+
+// Retries partial reads & writes (and interruptions) until done.
+absl::Status ReadFully(int fd, char* data, int64_t size) {
+  while (size > 0) {
+    const ssize_t count = recv(fd, data, size, 0);
+    if (count == 0) return absl::OutOfRangeError("End of stream");
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      return absl::UnavailableError(absl::StrCat("recv: ", strerror(errno)));
+    }
+    data += count;
+    size -= count;
+  }
+  return absl::OkStatus();
+}
+
+absl::Status WriteFully(int fd, const char* data, int64_t size) {
+  while (size > 0) {
+    const ssize_t count = send(fd, data, size, MSG_NOSIGNAL);
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      return absl::UnavailableError(absl::StrCat("send: ", strerror(errno)));
+    }
+    data += count;
+    size -= count;
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<sockaddr_un> CreateAddress(const std::string& socket_path) {
+  sockaddr_un address = {.sun_family = AF_UNIX};
+  if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid socket path: ", socket_path));
+  }
+  std::memcpy(address.sun_path, socket_path.data(), socket_path.size());
+  return address;
+}
+
+std::string EncodeResponse(int64_t request_id,
+                           const absl::StatusOr<Solution>& solution,
+                           const SolverStats& stats) {
+  std::string payload;
+  AppendInt64(payload, request_id);
+  AppendInt64(payload, static_cast<int64_t>(solution.status().code()));
+  if (!solution.ok()) {
+    absl::StrAppend(&payload, solution.status().message());
+    return payload;
+  }
+  AppendInt64(payload, stats.backtracks);
+  AppendInt64(payload, stats.nodes);
+  AppendInt64(payload, absl::ToInt64Nanoseconds(stats.sweep_time));
+  AppendInt64(payload, absl::ToInt64Nanoseconds(stats.setup_time));
+  AppendInt64(payload, absl::ToInt64Nanoseconds(stats.search_time));
+  AppendInt64(payload, solution->offsets.size());
+  for (const Offset offset : solution->offsets) AppendInt64(payload, offset);
+  return payload;
+}
+
+}  // namespace
+
+std::string EncodeSolveRequest(int64_t request_id, RequestFormat format,
+                               Capacity capacity, absl::string_view problem) {
+  std::string payload;
+  payload.reserve(kSolveHeaderWords * kWordSize + problem.size());
+  AppendInt64(payload, kSolveRequest);
+  AppendInt64(payload, request_id);
+  AppendInt64(payload, format);
+  AppendInt64(payload, capacity);
+  absl::StrAppend(&payload, problem);
+  return payload;
+}
+
+std::string EncodeCancelRequest(int64_t request_id) {
+  std::string payload;
+  AppendInt64(payload, kCancelRequest);
+  AppendInt64(payload, request_id);
+  return payload;
+}
+
+absl::StatusOr<SolveResponse> DecodeSolveResponse(absl::string_view payload) {
+  if (NumWords(payload) < 2) {
+    return absl::InvalidArgumentError("Truncated response");
+  }
+  SolveResponse response;
+  response.request_id = LoadInt64(payload, 0);
+  const auto code = static_cast<absl::StatusCode>(LoadInt64(payload, 1));
+  if (code != absl::StatusCode::kOk) {
+    response.solution = absl::Status(code, payload.substr(2 * kWordSize));
+    return response;
+  }
+  if (NumWords(payload) < 8 ||
+      NumWords(payload) != 8 + LoadInt64(payload, 7)) {
+    return absl::InvalidArgumentError("Truncated response");
+  }
+  response.stats = {
+      .backtracks = LoadInt64(payload, 2),
+      .nodes = LoadInt64(payload, 3),
+      .sweep_time = absl::Nanoseconds(LoadInt64(payload, 4)),
+      .setup_time = absl::Nanoseconds(LoadInt64(payload, 5)),
+      .search_time = absl::Nanoseconds(LoadInt64(payload, 6)),
+  };
+  Solution solution;
+  solution.offsets.reserve(LoadInt64(payload, 7));
+  for (int64_t word_idx = 8; word_idx < NumWords(payload); ++word_idx) {
+    solution.offsets.push_back(LoadInt64(payload, word_idx));
+  }
+  response.solution = std::move(solution);
+  return response;
+}
+
+absl::StatusOr<std::string> ReadFrame(int fd) {
+  std::string length(kWordSize, '\0');
+  if (absl::Status status = ReadFully(fd, length.data(), kWordSize);
+      !status.ok()) {
+    return status;
+  }
+  const int64_t size = LoadInt64(length, 0);
+  if (size < 0 || size > kMaxFrameSize) {
+    return absl::InvalidArgumentError("Invalid frame length");
+  }
+  std::string payload(size, '\0');
+  if (absl::Status status = ReadFully(fd, payload.data(), size); !status.ok()) {
+    return status;
+  }
+  return payload;
+}
+
+absl::Status WriteFrame(int fd, absl::string_view payload) {
+  std::string frame;
+  frame.reserve(kWordSize + payload.size());
+  AppendInt64(frame, payload.size());
+  absl::StrAppend(&frame, payload);
+  return WriteFully(fd, frame.data(), frame.size());
+}
+
+absl::StatusOr<int> ConnectToServer(const std::string& socket_path) {
+  const absl::StatusOr<sockaddr_un> address = CreateAddress(socket_path);
+  if (!address.ok()) return address.status();
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return absl::UnavailableError(absl::StrCat("socket: ", strerror(errno)));
+  }
+  if (connect(fd, reinterpret_cast<const sockaddr*>(&*address),
+              sizeof(*address)) < 0) {
+    const int error = errno;
+    close(fd);
+    return absl::UnavailableError(absl::StrCat("connect: ", strerror(error)));
+  }
+  return fd;
+}
+
+// The state of a single client connection, which outlives its solves.
+struct Server::Connection {
+  explicit Connection(int fd) : fd(fd) {}
+
+  const int fd;
+  absl::Mutex write_mutex;  // Serializes the responses written to fd.
+  absl::Mutex mutex;
+  absl::flat_hash_map<int64_t, std::shared_ptr<SolveContext>> contexts
+      ABSL_GUARDED_BY(mutex);
+  int64_t num_pending ABSL_GUARDED_BY(mutex) = 0;
+};
+
+absl::StatusOr<std::unique_ptr<Server>> Server::Create(
+    const std::string& socket_path, const SolverParams& params,
+    int num_threads, const SolutionCache* cache) {
+  const absl::StatusOr<sockaddr_un> address = CreateAddress(socket_path);
+  if (!address.ok()) return address.status();
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return absl::UnavailableError(absl::StrCat("socket: ", strerror(errno)));
+  }
+  unlink(socket_path.c_str());  // Removes a socket left behind by a crash.
+  if (bind(fd, reinterpret_cast<const sockaddr*>(&*address),
+           sizeof(*address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+    const int error = errno;
+    close(fd);
+    return absl::UnavailableError(
+        absl::StrCat("Cannot listen at ", socket_path, ": ", strerror(error)));
+  }
+  return std::unique_ptr<Server>(
+      new Server(socket_path, fd, params, num_threads, cache));
+}
+
+Server::Server(const std::string& socket_path, int listen_fd,
+               const SolverParams& params, int num_threads,
+               const SolutionCache* cache)
+    : socket_path_(socket_path), listen_fd_(listen_fd),
+      solver_(params, cache), cache_(cache), thread_pool_(num_threads) {}
+
+Server::~Server() {
+  Shutdown();
+  close(listen_fd_);
+  unlink(socket_path_.c_str());
+}
+
+void Server::Serve() {
+  while (true) {
+    const int fd = accept(listen_fd_, nullptr, nullptr);
+    const int error = errno;
+    absl::MutexLock lock(&mutex_);
+    if (shutdown_) {
+      if (fd >= 0) close(fd);
+      break;
+    }
+    if (fd < 0) {
+      // Keep going if the client gave up (or a signal arrived).
+      if (error == EINTR || error == ECONNABORTED) continue;
+      break;
+    }
+    open_fds_.insert(fd);
+    JoinFinishedConnections();
+    const int64_t connection_id = num_connections_++;
+    connection_threads_.emplace(
+        connection_id,
+        std::thread(&Server::HandleConnection, this, connection_id, fd));
+  }
+  // The remaining connections need the lock to finish, so join them without it.
+  absl::flat_hash_map<int64_t, std::thread> connection_threads;
+  {
+    absl::MutexLock lock(&mutex_);
+    connection_threads.swap(connection_threads_);
+  }
+  for (auto& [connection_id, thread] : connection_threads) thread.join();
+  absl::MutexLock lock(&mutex_);
+  finished_connections_.clear();
+}
+
+void Server::JoinFinishedConnections() {
+  // Each of these threads has nothing left to do but return.
+  for (const int64_t connection_id : finished_connections_) {
+    auto it = connection_threads_.find(connection_id);
+    it->second.join();
+    connection_threads_.erase(it);
+  }
+  finished_connections_.clear();
+}
+
+void Server::Shutdown() {
+  absl::MutexLock lock(&mutex_);
+  shutdown_ = true;
+  shutdown(listen_fd_, SHUT_RDWR);  // Wakes up any pending accept.
+  for (const int fd : open_fds_) shutdown(fd, SHUT_RD);
+}
+
+void Server::HandleConnection(int64_t connection_id, int fd) {
+  Connection connection(fd);
+  while (true) {
+    absl::StatusOr<std::string> payload = ReadFrame(fd);
+    if (!payload.ok()) break;
+    HandleRequest(connection, *std::move(payload));
+  }
+  // Abandon every solve in flight, and wait for them to respond.
+  {
+    absl::MutexLock lock(&connection.mutex);
+    for (auto& [request_id, context] : connection.contexts) context->Cancel();
+    connection.mutex.Await(absl::Condition(
+        +[](int64_t* num_pending) { return *num_pending == 0; },
+        &connection.num_pending));
+  }
+  absl::MutexLock lock(&mutex_);
+  open_fds_.erase(fd);
+  close(fd);
+  finished_connections_.push_back(connection_id);
+}
+
+void Server::HandleRequest(Connection& connection, std::string payload) {
+  if (NumWords(payload) < 2) return;  // Not even a request id to respond to.
+  const int64_t type = LoadInt64(payload, 0);
+  const int64_t request_id = LoadInt64(payload, 1);
+  if (type == kCancelRequest) {
+    absl::MutexLock lock(&connection.mutex);
+    if (auto it = connection.contexts.find(request_id);
+        it != connection.contexts.end()) {
+      it->second->Cancel();
+    }
+    return;
+  }
+  const auto respond = [&connection, request_id](
+      const absl::StatusOr<Solution>& solution, const SolverStats& stats) {
+    absl::MutexLock lock(&connection.write_mutex);
+    // A failure here means the client has gone away, so there is no one left
+    // to notify.
+    WriteFrame(connection.fd, EncodeResponse(request_id, solution, stats))
+        .IgnoreError();
+  };
+  if (type != kSolveRequest || NumWords(payload) < kSolveHeaderWords) {
+    respond(absl::InvalidArgumentError("Malformed request"), SolverStats());
+    return;
+  }
+  const int64_t format = LoadInt64(payload, 2);
+  const Capacity capacity = LoadInt64(payload, 3);
+  if (format != kCsvFormat && format != kBinaryFormat) {
+    respond(absl::InvalidArgumentError("Unknown format"), SolverStats());
+    return;
+  }
+  auto context = std::make_shared<SolveContext>();
+  {
+    absl::MutexLock lock(&connection.mutex);
+    if (!connection.contexts.try_emplace(request_id, context).second) {
+      respond(absl::AlreadyExistsError("Duplicate request id"), SolverStats());
+      return;
+    }
+    ++connection.num_pending;
+  }
+  thread_pool_.Schedule([this, &connection, request_id, format, capacity,
+                         context, respond, payload = std::move(payload)]() {
+    // The problem begins on a word boundary, as binary views require.
+    const absl::string_view input =
+        absl::string_view(payload).substr(kSolveHeaderWords * kWordSize);
+    absl::StatusOr<Problem> problem =
+        format == kBinaryFormat ? FromBinary(input) : FromCsv(input);
+    if (problem.ok()) {
+      problem->capacity = capacity;
+      respond(cache_ ? SolveWithCache(solver_, *cache_, *problem, *context)
+                     : solver_.Solve(*problem, *context),
+              context->get_stats());
+    } else {
+      respond(problem.status(), context->get_stats());
+    }
+    absl::MutexLock lock(&connection.mutex);
+    connection.contexts.erase(request_id);
+    --connection.num_pending;
+  });
+}
+
+}  // namespace minimalloc
@@ -0,0 +1,138 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef MINIMALLOC_SRC_SERVER_H_
+#define MINIMALLOC_SRC_SERVER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "minimalloc.h"
+#include "solution_cache.h"
+#include "solver.h"
+#include "thread_pool.h"
+
+namespace minimalloc {
+
+// A long-running solver that accepts requests over a Unix domain socket.  Each
+// message (in either direction) is a frame consisting of an eight-byte length
+// followed by a payload of that many bytes.  Payloads are sequences of
+// little-endian int64 values:
+//
+//   solve     kSolveRequest, request_id, format, capacity, problem bytes...
+//   cancel    kCancelRequest, request_id
+//   response  request_id, status code, then either the backtracks, nodes,
+//             sweep / setup / search nanoseconds, offset count and offsets (if
+//             the status is OK), or else the error message
+//
+// Request ids are chosen by the client and are scoped to its connection.  A
+// connection may have many solves in flight, whose responses are sent as each
+// one completes; a cancelled solve responds with DEADLINE_EXCEEDED.
+enum RequestType : int64_t {
+  kSolveRequest = 1,
+  kCancelRequest = 2,
+};
+
+enum RequestFormat : int64_t {
+  kCsvFormat = 0,
+  kBinaryFormat = 1,  // As produced by ToBinary.
+};
+
+struct SolveResponse {
+  int64_t request_id = 0;
+  absl::StatusOr<Solution> solution;
+  SolverStats stats;
+};
+
+std::string EncodeSolveRequest(int64_t request_id, RequestFormat format,
+                               Capacity capacity, absl::string_view problem);
+std::string EncodeCancelRequest(int64_t request_id);
+absl::StatusOr<SolveResponse> DecodeSolveResponse(absl::string_view payload);
+
+// The largest payload that ReadFrame accepts.
+constexpr int64_t kMaxFrameSize = int64_t{1} << 30;
+
+// Reads or writes a single frame, where reading at the end of the stream
+// returns an OUT_OF_RANGE status (and a length beyond kMaxFrameSize returns an
+// INVALID_ARGUMENT status, without reading the payload).
+absl::StatusOr<std::string> ReadFrame(int fd);
+absl::Status WriteFrame(int fd, absl::string_view payload);
+
+// Connects to a server, returning the connected socket (which the caller must
+// close).
+absl::StatusOr<int> ConnectToServer(const std::string& socket_path);
+
+class Server {
+ public:
+  // Listens at the given path (replacing any stale socket), and solves requests
+  // on a pool of num_threads workers that is kept for the server's lifetime.
+  // If a cache is given (which must outlive the server), it is consulted (and
+  // populated) via SolveWithCache.
+  static absl::StatusOr<std::unique_ptr<Server>> Create(
+      const std::string& socket_path, const SolverParams& params,
+      int num_threads, const SolutionCache* cache = nullptr);
+  ~Server();
+
+  Server(const Server&) = delete;
+  Server& operator=(const Server&) = delete;
+
+  // Accepts connections until shut down, then waits for every connection to
+  // close.  Must return before the server is destroyed.
+  void Serve();
+
+  // Stops accepting connections, and closes those that are open (cancelling
+  // any solves in flight).  Safe to call from any thread.
+  void Shutdown();
+
+ private:
+  struct Connection;
+
+  Server(const std::string& socket_path, int listen_fd,
+         const SolverParams& params, int num_threads,
+         const SolutionCache* cache);
+  void HandleConnection(int64_t connection_id, int fd);
+  // Joins the threads of any connections that have closed.
+  void JoinFinishedConnections() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void HandleRequest(Connection& connection, std::string payload);
+
+  const std::string socket_path_;
+  const int listen_fd_;
+  const Solver solver_;
+  const SolutionCache* const cache_;
+  ThreadPool thread_pool_;
+  absl::Mutex mutex_;
+  bool shutdown_ ABSL_GUARDED_BY(mutex_) = false;
+  absl::flat_hash_set<int> open_fds_ ABSL_GUARDED_BY(mutex_);
+  // The thread of each connection (by id), and those that have since closed.
+  absl::flat_hash_map<int64_t, std::thread> connection_threads_
+      ABSL_GUARDED_BY(mutex_);
+  std::vector<int64_t> finished_connections_ ABSL_GUARDED_BY(mutex_);
+  int64_t num_connections_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace minimalloc
+
+#endif  // MINIMALLOC_SRC_SERVER_H_
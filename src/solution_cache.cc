@@ -0,0 +1,258 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "solution_cache.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "minimalloc.h"
+#include "solver.h"
+#include "validator.h"
+
+namespace minimalloc {
+namespace {
+
+// Bumped whenever the key or entry format changes, to orphan old entries.
+constexpr int64_t kFormatVersion = 1;
+constexpr char kMagic[] = "MMSC";
+constexpr int64_t kNoValue = INT64_MIN;
+
+// The splitmix64 finalizer, whose output (unlike absl::Hash) is the same in
+// every process.
+uint64_t Mix(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+// Describes a buffer (minus its id) as a sequence of words.
+std::vector<int64_t> Describe(const Buffer& buffer) {
+  std::vector<int64_t> words = {
+      buffer.lifespan.lower(), buffer.lifespan.upper(), buffer.size,
+      buffer.alignment, buffer.offset.value_or(kNoValue),
+      buffer.hint.value_or(kNoValue),
+      static_cast<int64_t>(buffer.gaps.size())};
+  for (const Gap& gap : buffer.gaps) {
+    words.push_back(gap.lifespan.lower());
+    words.push_back(gap.lifespan.upper());
+    words.push_back(gap.window ? gap.window->lower() : kNoValue);
+    words.push_back(gap.window ? gap.window->upper() : kNoValue);
+  }
+  return words;
+}
+
+// The canonical form of a problem: the description of each buffer, and the
+// permutation that sorts them.
+struct CanonicalProblem {
+  std::vector<std::vector<int64_t>> descriptions;
+  std::vector<BufferIdx> order;  // The original index of each sorted buffer.
+};
+
+CanonicalProblem Canonicalize(const Problem& problem) {
+  CanonicalProblem canonical;
+  canonical.descriptions.reserve(problem.buffers.size());
+  for (const Buffer& buffer : problem.buffers) {
+    canonical.descriptions.push_back(Describe(buffer));
+  }
+  canonical.order.resize(problem.buffers.size());
+  std::iota(canonical.order.begin(), canonical.order.end(), 0);
+  std::stable_sort(canonical.order.begin(), canonical.order.end(),
+                   [&canonical](BufferIdx a, BufferIdx b) {
+                     return canonical.descriptions[a] <
+                            canonical.descriptions[b];
+                   });
+  return canonical;
+}
+
+std::string ComputeCanonicalKey(const CanonicalProblem& canonical,
+                                const Problem& problem,
+                                const SolverParams& params) {
+  // Two independent lanes yield a 128-bit digest.
+  uint64_t lanes[2] = {0x6d696e696d616c6c, 0x6f632d6361636865};
+  const auto add = [&lanes](int64_t word) {
+    lanes[0] = Mix(lanes[0] ^ static_cast<uint64_t>(word));
+    lanes[1] = Mix(lanes[1] + static_cast<uint64_t>(word) + 1);
+  };
+  add(kFormatVersion);
+  add(params.canonical_only);
+  add(params.section_inference);
+  add(params.dynamic_ordering);
+  add(params.check_dominance);
+  add(params.unallocated_floor);
+  add(params.static_preordering);
+  add(params.dynamic_decomposition);
+  add(params.monotonic_floor);
+  add(params.hatless_pruning);
+  add(params.deduplicate_partitions);
+  add(params.break_symmetries);
+  add(params.normalize_scale);
+  add(params.small_partition_search);
+  add(params.dense_overlaps);
+  add(params.preordering_heuristics.size());
+  for (const PreorderingHeuristic& heuristic : params.preordering_heuristics) {
+    add(heuristic.size());
+    for (const char c : heuristic) add(c);
+  }
+  add(problem.capacity);
+  add(canonical.order.size());
+  for (const BufferIdx buffer_idx : canonical.order) {
+    const std::vector<int64_t>& description =
+        canonical.descriptions[buffer_idx];
+    add(description.size());
+    for (const int64_t word : description) add(word);
+  }
+  return absl::StrFormat("%016x%016x", lanes[0], lanes[1]);
+}
+
+void AppendVarint(std::string& output, uint64_t value) {
+  while (value >= 0x80) {
+    output.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  output.push_back(static_cast<char>(value));
+}
+
+bool ParseVarint(const std::string& input, size_t& pos, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && pos < input.size(); shift += 7) {
+    const uint8_t byte = input[pos++];
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+std::string SolutionCache::ComputeKey(const Problem& problem,
+                                      const SolverParams& params) {
+  return ComputeCanonicalKey(Canonicalize(problem), problem, params);
+}
+
+std::string SolutionCache::GetPath(const std::string& key) const {
+  return (std::filesystem::path(dir_) / key).string();
+}
+
+absl::StatusOr<Solution> SolutionCache::Lookup(
+    const Problem& problem, const SolverParams& params) const {
+  const CanonicalProblem canonical = Canonicalize(problem);
+  const std::string path =
+      GetPath(ComputeCanonicalKey(canonical, problem, params));
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs) return absl::NotFoundError("Cache miss");
+  const std::string entry((std::istreambuf_iterator<char>(ifs)),
+                          std::istreambuf_iterator<char>());
+  size_t pos = sizeof(kMagic) - 1;
+  uint64_t num_offsets = 0;
+  if (entry.compare(0, pos, kMagic) != 0 ||
+      !ParseVarint(entry, pos, num_offsets) ||
+      num_offsets != problem.buffers.size()) {
+    return absl::NotFoundError(absl::StrCat("Malformed cache entry ", path));
+  }
+  Solution solution;
+  solution.offsets.resize(num_offsets);
+  for (const BufferIdx buffer_idx : canonical.order) {
+    uint64_t offset = 0;
+    if (!ParseVarint(entry, pos, offset)) {
+      return absl::NotFoundError(absl::StrCat("Malformed cache entry ", path));
+    }
+    solution.offsets[buffer_idx] = offset;
+  }
+  if (pos != entry.size() || Validate(problem, solution) != kGood) {
+    return absl::NotFoundError(absl::StrCat("Invalid cache entry ", path));
+  }
+  return solution;
+}
+
+absl::Status SolutionCache::Store(const Problem& problem,
+                                  const SolverParams& params,
+                                  const Solution& solution) const {
+  if (solution.offsets.size() != problem.buffers.size()) {
+    return absl::InvalidArgumentError("Solution does not match the problem");
+  }
+  const CanonicalProblem canonical = Canonicalize(problem);
+  std::string entry = kMagic;
+  AppendVarint(entry, solution.offsets.size());
+  for (const BufferIdx buffer_idx : canonical.order) {
+    if (solution.offsets[buffer_idx] < 0) {
+      return absl::InvalidArgumentError("Negative offset");
+    }
+    AppendVarint(entry, solution.offsets[buffer_idx]);
+  }
+  std::error_code error;
+  std::filesystem::create_directories(dir_, error);
+  if (error) {
+    return absl::UnavailableError(absl::StrCat("Cannot create ", dir_));
+  }
+  // Write to a file of our own (named for this process, thread and write, as
+  // other processes may share the directory), then rename it into place so
+  // that concurrent readers never observe a partial entry.
+  static std::atomic<int64_t> num_writes = 0;
+  const std::string path =
+      GetPath(ComputeCanonicalKey(canonical, problem, params));
+  const std::string temp_path = absl::StrCat(
+      path, ".", getpid(), ".",
+      std::hash<std::thread::id>()(std::this_thread::get_id()), ".",
+      num_writes++, ".tmp");
+  {
+    std::ofstream ofs(temp_path, std::ios::binary);
+    ofs << entry;
+    if (!ofs.good()) {
+      return absl::UnavailableError(absl::StrCat("Cannot write ", temp_path));
+    }
+  }
+  std::filesystem::rename(temp_path, path, error);
+  if (error) {
+    std::filesystem::remove(temp_path, error);
+    return absl::UnavailableError(absl::StrCat("Cannot write ", path));
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<Solution> SolveWithCache(const Solver& solver,
+                                        const SolutionCache& cache,
+                                        const Problem& problem,
+                                        SolveContext& context) {
+  absl::StatusOr<Solution> solution =
+      cache.Lookup(problem, solver.get_params());
+  if (solution.ok()) return solution;
+  solution = solver.Solve(problem, context);
+  if (solution.ok()) {
+    // A failure to populate the cache shouldn't fail the solve itself.
+    cache.Store(problem, solver.get_params(), *solution).IgnoreError();
+  }
+  return solution;
+}
+
+}  // namespace minimalloc
@@ -0,0 +1,66 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#ifndef MINIMALLOC_SRC_SOLUTION_CACHE_H_
+#define MINIMALLOC_SRC_SOLUTION_CACHE_H_
+
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "minimalloc.h"
+#include "solver.h"
+
+namespace minimalloc {
+
+// A content-addressed store of solutions in a directory on disk, which may be
+// shared by many processes.  Entries are keyed by a canonical hash of the
+// problem (whose buffers are sorted, with ids ignored) and of the solver
+// params that affect the search (ie, all but the timeout).  Each entry holds
+// the offsets of the sorted buffers as a sequence of varints.
+class SolutionCache {
+ public:
+  explicit SolutionCache(std::string dir) : dir_(std::move(dir)) {}
+
+  // Returns a 32-digit hexadecimal key, which is stable across processes.
+  static std::string ComputeKey(const Problem& problem,
+                                const SolverParams& params);
+
+  // Returns the cached solution, provided that it passes validation, or else a
+  // NOT_FOUND status.
+  absl::StatusOr<Solution> Lookup(const Problem& problem,
+                                  const SolverParams& params) const;
+
+  // Adds (or replaces) a solution, atomically with respect to other readers.
+  absl::Status Store(const Problem& problem, const SolverParams& params,
+                     const Solution& solution) const;
+
+ private:
+  std::string GetPath(const std::string& key) const;
+
+  const std::string dir_;
+};
+
+// Returns the cached solution to the problem if there is one, or else solves
+// it (adding any solution found to the cache).
+absl::StatusOr<Solution> SolveWithCache(const Solver& solver,
+                                        const SolutionCache& cache,
+                                        const Problem& problem,
+                                        SolveContext& context);
+
+}  // namespace minimalloc
+
+#endif  // MINIMALLOC_SRC_SOLUTION_CACHE_H_
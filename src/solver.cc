@@ -16,104 +16,394 @@ limitations under the License.
 
 #include "solver.h"
 
-#include <limits.h>
-
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
 #include <cstdint>
 #include <limits>
 #include <optional>
+#include <span>
+#include <utility>
 #include <vector>
 
 #include "absl/algorithm/container.h"
-#include "absl/container/flat_hash_set.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "minimalloc.h"
+#include "presolve.h"
+#include "solution_cache.h"
 #include "sweeper.h"
 
 namespace minimalloc {
 namespace {
 
+// Partitions with fewer buffers than this aren't worth a trip to the disk.
+constexpr int64_t kMinCachedPartitionSize = 16;
+
+// Partitions with at most this many buffers (and sections) may use the small
+// partition search (see SolverImpl::SolveSmallPartition).
+constexpr int kMaxSmallPartitionSize = 12;
+constexpr int kMaxSmallPartitionSections = 4 * kMaxSmallPartitionSize;
+
+// Partitions within these bounds on their number of buffers may track their
+// overlaps as bitsets (see DenseOverlaps), so long as each buffer overlaps with
+// at least 1 / kDenseOverlapsRatio of the others on average.
+constexpr int kMinDenseOverlapsSize = 64;
+constexpr int kMaxDenseOverlapsSize = 4096;
+constexpr int kDenseOverlapsRatio = 8;
+
 using PreorderIdx = int;  // An index into a preordered buffer list.
 
 constexpr int kNoOffset = -1;
 
+// The search features that are consulted at every node, which SolverImpl
+// resolves at compile time for the configurations listed further below.
+using SearchFeatures = uint32_t;
+
+constexpr SearchFeatures kCanonicalOnly = 1 << 0;
+constexpr SearchFeatures kSectionInference = 1 << 1;
+constexpr SearchFeatures kDynamicOrdering = 1 << 2;
+constexpr SearchFeatures kCheckDominance = 1 << 3;
+constexpr SearchFeatures kUnallocatedFloor = 1 << 4;
+constexpr SearchFeatures kDynamicDecomposition = 1 << 5;
+constexpr SearchFeatures kMonotonicFloor = 1 << 6;
+constexpr SearchFeatures kHatlessPruning = 1 << 7;
+constexpr SearchFeatures kBreakSymmetries = 1 << 8;
+constexpr int kNumParamFeatures = 9;
+constexpr SearchFeatures kDefaultFeatures = (1 << kNumParamFeatures) - 1;
+// Not a param, but a property of the problem: every buffer spans exactly one
+// contiguous run of sections (ie, it has no gaps).
+constexpr SearchFeatures kGapless = 1 << kNumParamFeatures;
+// Instructs SolverImpl to look up its features at runtime instead.
+constexpr SearchFeatures kRuntimeFeatures = 1u << 31;
+
+SearchFeatures GetSearchFeatures(const SolverParams& params,
+                                 const SweepResult& sweep_result) {
+  SearchFeatures features = 0;
+  if (params.canonical_only) features |= kCanonicalOnly;
+  if (params.section_inference) features |= kSectionInference;
+  if (params.dynamic_ordering) features |= kDynamicOrdering;
+  if (params.check_dominance) features |= kCheckDominance;
+  if (params.unallocated_floor) features |= kUnallocatedFloor;
+  if (params.dynamic_decomposition) features |= kDynamicDecomposition;
+  if (params.monotonic_floor) features |= kMonotonicFloor;
+  if (params.hatless_pruning) features |= kHatlessPruning;
+  if (params.break_symmetries) features |= kBreakSymmetries;
+  if (absl::c_all_of(sweep_result.buffer_data, [](const BufferData& data) {
+        return data.section_spans.size() == 1;
+      })) {
+    features |= kGapless;
+  }
+  return features;
+}
+
+// The configurations that receive their own (32-bit) instantiation of
+// SolverImpl: the defaults, the defaults less any one feature (as in the
+// ablation suite), and no features at all, each with and without gaps.
+constexpr auto kSpecializedFeatures = [] {
+  std::array<SearchFeatures, 2 * (kNumParamFeatures + 2)> features = {};
+  int idx = 0;
+  for (const SearchFeatures gapless : {SearchFeatures{0}, kGapless}) {
+    features[idx++] = kDefaultFeatures | gapless;
+    for (int bit = 0; bit < kNumParamFeatures; ++bit) {
+      features[idx++] = (kDefaultFeatures & ~(1u << bit)) | gapless;
+    }
+    features[idx++] = gapless;
+  }
+  return features;
+}();
+
+// The few problems that need 64 bits are only specialized for the defaults.
+constexpr std::array<SearchFeatures, 2> kWideSpecializedFeatures = {
+    kDefaultFeatures, kDefaultFeatures | kGapless};
+
+// Returns whether every index & offset the search may encounter fits in 32
+// bits.  A placed buffer never rises above the capacity (or its fixed offset),
+// so a minimum offset exceeds this by at most a size and an alignment, and a
+// section's floor by at most the total of its sizes.
+bool FitsInt32(const Problem& problem) {
+  int64_t max_offset = problem.capacity, max_size = 0, max_alignment = 1;
+  int64_t total_size = 0;
+  for (const Buffer& buffer : problem.buffers) {
+    max_offset = std::max(max_offset, buffer.offset.value_or(0));
+    max_size = std::max(max_size, buffer.size);
+    max_alignment = std::max(max_alignment, buffer.alignment);
+    total_size += buffer.size;
+    if (total_size > std::numeric_limits<int32_t>::max()) return false;
+  }
+  return max_offset + 2 * (max_size + max_alignment) + total_size <=
+         std::numeric_limits<int32_t>::max();
+}
+
 // Used to incrementally maintain data about sections during search.
+template <typename OffsetT>
 struct SectionData {
-  Offset floor = 0;  // The lowest viable offset for any buffer in this section.
-  int total = 0;  // A sum of the total unallocated buffer sizes in the section.
+  OffsetT floor = 0;  // The lowest viable offset for any buffer in the section.
+  OffsetT total = 0;  // The total size of unallocated buffers in the section.
 };
 
 // Data used to help establish a dynamic ordering of buffers.
+template <typename OffsetT>
 struct OrderData {
-  Offset offset = 0;
+  OffsetT offset = 0;
   PreorderIdx preorder_idx = 0;
 };
 
 // A record of a buffer's minimum offset value prior to a change during search.
+template <typename IdxT, typename OffsetT>
 struct OffsetChange {
-  BufferIdx buffer_idx;
-  Offset min_offset;
+  IdxT buffer_idx;
+  OffsetT min_offset;
 };
 
 // A record of a section's floor value prior to a change during search.
+template <typename OffsetT>
 struct SectionChange {
   SectionIdx section_idx;
-  Offset floor;
+  OffsetT floor;
+};
+
+// An overlap (see sweeper.h) in the solver's own index & offset types.
+template <typename IdxT, typename OffsetT>
+struct CompactOverlap {
+  IdxT buffer_idx;
+  OffsetT effective_size;
+};
+
+// A segment tree that answers range-maximum queries over section totals, so
+// that a buffer's maximum total is found without visiting each of its sections.
+class RangeMax {
+ public:
+  RangeMax() = default;
+
+  // Builds the tree over the given values, which belong to sections beginning
+  // with 'lower' (i.e., values[0] corresponds to section 'lower').
+  RangeMax(SectionIdx lower, std::vector<int64_t> values)
+      : lower_(lower), size_(values.size()), tree_(2 * values.size()) {
+    absl::c_copy(values, tree_.begin() + size_);
+    for (SectionIdx idx = size_ - 1; idx > 0; --idx) {
+      tree_[idx] = std::max(tree_[2 * idx], tree_[2 * idx + 1]);
+    }
+  }
+
+  // Returns the maximum value in the given (nonempty) range of sections.
+  int64_t Query(const SectionRange& section_range) const {
+    int64_t result = std::numeric_limits<int64_t>::min();
+    SectionIdx lower = section_range.lower() - lower_ + size_;
+    SectionIdx upper = section_range.upper() - lower_ + size_;
+    for (; lower < upper; lower /= 2, upper /= 2) {
+      if (lower % 2 == 1) result = std::max(result, tree_[lower++]);
+      if (upper % 2 == 1) result = std::max(result, tree_[--upper]);
+    }
+    return result;
+  }
+
+ private:
+  SectionIdx lower_ = 0;
+  SectionIdx size_ = 0;
+  std::vector<int64_t> tree_;
+};
+
+// The buffer attributes read during search, packed into parallel arrays so
+// that the cold parts of each Buffer (its id, gaps and so on) stay out of the
+// cache.  Buffers without a fixed offset are given kNoFixedOffset.
+template <typename OffsetT>
+struct BufferTable {
+  static constexpr OffsetT kNoFixedOffset = std::numeric_limits<OffsetT>::max();
+
+  BufferTable(const Problem& problem, const SweepResult& sweep_result) {
+    const auto num_buffers = problem.buffers.size();
+    sizes.reserve(num_buffers);
+    alignments.reserve(num_buffers);
+    fixed_offsets.reserve(num_buffers);
+    section_ranges.reserve(num_buffers);
+    for (BufferIdx buffer_idx = 0; buffer_idx < num_buffers; ++buffer_idx) {
+      const Buffer& buffer = problem.buffers[buffer_idx];
+      sizes.push_back(buffer.size);
+      alignments.push_back(buffer.alignment);
+      fixed_offsets.push_back(buffer.offset.value_or(kNoFixedOffset));
+      const std::vector<SectionSpan>& section_spans =
+          sweep_result.buffer_data[buffer_idx].section_spans;
+      section_ranges.push_back(section_spans.empty() ? SectionRange{0, 0}
+          : SectionRange{section_spans.front().section_range.lower(),
+                         section_spans.back().section_range.upper()});
+    }
+  }
+
+  std::vector<OffsetT> sizes;
+  std::vector<OffsetT> alignments;
+  std::vector<OffsetT> fixed_offsets;
+  // From the first section spanned by each buffer to the last.
+  std::vector<SectionRange> section_ranges;
+};
+
+// Rounds an offset up to the nearest multiple of the alignment.
+template <typename OffsetT>
+OffsetT AlignUp(OffsetT offset, OffsetT alignment) {
+  // Powers of two (by far the most common) can be rounded with a mask.
+  if ((alignment & (alignment - 1)) == 0) {
+    return (offset + alignment - 1) & -alignment;
+  }
+  const OffsetT diff = offset % alignment;
+  return diff > 0 ? offset + alignment - diff : offset;
+}
+
+// The state of a small partition's search, held in fixed-size arrays that are
+// indexed by each buffer's position within the partition (with any set of
+// positions stored as a bitmask).
+template <typename OffsetT>
+struct SmallPartition {
+  using Mask = uint32_t;
+  static constexpr int kSize = kMaxSmallPartitionSize;
+  using SectionArray = std::array<OffsetT, kMaxSmallPartitionSections>;
+
+  int num_buffers = 0;
+  std::array<BufferIdx, kSize> buffer_idxs;
+  std::array<OffsetT, kSize> min_offsets;  // As of the start of the search.
+  std::array<OffsetT, kSize> sizes;
+  std::array<OffsetT, kSize> alignments;
+  std::array<OffsetT, kSize> fixed_offsets;
+  std::array<int, kSize> previous;  // See FindPreviousEquivalents.
+  std::array<Mask, kSize> overlaps;
+  // How far above one buffer's offset an overlapping buffer must be placed.
+  std::array<std::array<OffsetT, kSize>, kSize> effective_sizes;
+  std::array<OffsetT, kSize> offsets;  // The offsets of placed buffers.
+  // The section data (see SectionData) of the partition's sections, relative
+  // to the first.
+  SectionIdx first_section = 0;
+  int num_sections = 0;
+  SectionArray floors;
+  SectionArray totals;
+};
+
+// The overlaps (see sweeper.h) among a partition's buffers, held as one bitset
+// per buffer and indexed by each buffer's position within the partition.  The
+// effective sizes of each row are packed in order of position, so the size of
+// an overlap is found by counting the bits of its row that precede it.
+template <typename IdxT, typename OffsetT>
+struct DenseOverlaps {
+  using Word = uint64_t;
+  static constexpr int kWordBits = std::numeric_limits<Word>::digits;
+
+  int num_words = 0;  // The number of words in each bitset.
+  std::vector<IdxT> buffer_idxs;  // The buffer at each position.
+  std::vector<Word> rows;  // The positions overlapping with each position.
+  // The index into effective_sizes of the first bit in each word of each row.
+  std::vector<int64_t> ranks;
+  std::vector<OffsetT> effective_sizes;
+  std::vector<Word> unplaced;  // The positions of buffers not yet placed.
 };
 
 // Dynamically orders buffers by minimum offset, followed by preorder index.
 const auto kDynamicComparator =
-    [](const OrderData& a, const OrderData& b) {
+    [](const auto& a, const auto& b) {
       if (a.offset != b.offset) return a.offset < b.offset;
       return a.preorder_idx < b.preorder_idx;
     };
 
+// The search itself, which stores its indices & offsets as IdxT & OffsetT (so
+// that problems fitting in 32 bits keep their hot data half the size).
+template <typename IdxT, typename OffsetT, SearchFeatures kFeatures>
 class SolverImpl {
  public:
   SolverImpl(const SolverParams& params, const absl::Time start_time,
       const Problem& problem, const SweepResult& sweep_result,
-      int64_t* backtracks, std::atomic<bool>& cancelled) : params_(params),
-      start_time_(start_time), problem_(problem), sweep_result_(sweep_result),
-      backtracks_(*backtracks), cancelled_(cancelled) {}
+      SolveContext& context, const SolutionCache* partition_cache,
+      SearchFeatures features)
+      : params_(params), start_time_(start_time), problem_(problem),
+      sweep_result_(sweep_result), stats_(*context.mutable_stats()),
+      context_(context), partition_cache_(partition_cache),
+      features_(features), buffer_table_(problem, sweep_result) {}
 
   absl::StatusOr<Solution> Solve() {
     if (problem_.buffers.empty()) return solution_;
+    const absl::Time setup_start_time = absl::Now();
     const auto num_buffers = problem_.buffers.size();
-    assignment_.offsets.resize(num_buffers, kNoOffset);
+    assignment_.resize(num_buffers, kNoOffset);
     solution_.offsets.resize(num_buffers, kNoOffset);
     min_offsets_.resize(num_buffers);
     section_data_.resize(sweep_result_.sections.size());
+    const std::vector<int64_t> totals = sweep_result_.CalculateTotals();
+    for (SectionIdx s_idx = 0; s_idx < totals.size(); ++s_idx) {
+      section_data_[s_idx].total = totals[s_idx];
+    }
     for (BufferIdx buffer_idx = 0; buffer_idx < num_buffers; ++buffer_idx) {
-      const BufferData& buffer_data = sweep_result_.buffer_data[buffer_idx];
-      for (const SectionSpan& section_span : buffer_data.section_spans) {
-        const SectionRange& section_range = section_span.section_range;
-        const Window& window = section_span.window;
-        for (SectionIdx s_idx = section_range.lower();
-            s_idx < section_range.upper(); ++s_idx) {
-          section_data_[s_idx].total += window.upper() - window.lower();
-        }
-      }
       if (const Buffer& buffer = problem_.buffers[buffer_idx]; buffer.offset) {
         min_offsets_[buffer_idx] = *buffer.offset;
       }
     }
+    section_starts_.reserve(sweep_result_.sections.size() + 1);
+    section_starts_.push_back(0);
+    for (const Section& section : sweep_result_.sections) {
+      section_members_.insert(section_members_.end(), section.begin(),
+                              section.end());
+      section_starts_.push_back(section_members_.size());
+    }
+    section_stamps_.resize(sweep_result_.sections.size());
+    if (params_.dense_overlaps) dense_positions_.resize(num_buffers, -1);
+    overlaps_.resize(num_buffers);
+    for (BufferIdx buffer_idx = 0; buffer_idx < num_buffers; ++buffer_idx) {
+      const BufferData& buffer_data = sweep_result_.buffer_data[buffer_idx];
+      overlaps_[buffer_idx].reserve(buffer_data.overlaps.size());
+      for (const Overlap& overlap : buffer_data.overlaps) {
+        overlaps_[buffer_idx].push_back(
+            {.buffer_idx = static_cast<IdxT>(overlap.buffer_idx),
+             .effective_size = static_cast<OffsetT>(overlap.effective_size)});
+      }
+    }
+    if (params_.break_symmetries) {
+      previous_equivalents_ = FindPreviousEquivalents(problem_);
+    }
     cuts_ = sweep_result_.CalculateCuts();
+    // The preordering data of each partition is shared by every heuristic.
+    const RangeMax section_totals = CreateRangeMax(
+        {0, static_cast<SectionIdx>(sweep_result_.sections.size())});
+    preorderings_.reserve(sweep_result_.partitions.size());
+    for (const Partition& partition : sweep_result_.partitions) {
+      preorderings_.push_back(ComputePreordering(partition, section_totals));
+    }
+    const absl::Time search_start_time = absl::Now();
+    stats_.setup_time += search_start_time - setup_start_time;
+    absl::StatusOr<Solution> solution = Search();
+    stats_.search_time += absl::Now() - search_start_time;
+    return solution;
+  }
+
+ private:
+  // Returns whether a feature is enabled, which is known at compile time for
+  // every instantiation other than kRuntimeFeatures.
+  bool Enabled(SearchFeatures feature) const {
+    if constexpr (kFeatures == kRuntimeFeatures) {
+      return (features_ & feature) != 0;
+    } else {
+      return (kFeatures & feature) != 0;
+    }
+  }
+
+  // Returns the section spans of a buffer (of which gapless buffers have one).
+  std::span<const SectionSpan> GetSectionSpans(BufferIdx buffer_idx) const {
+    const std::vector<SectionSpan>& section_spans =
+        sweep_result_.buffer_data[buffer_idx].section_spans;
+    if (Enabled(kGapless)) return {section_spans.data(), 1};
+    return section_spans;
+  }
+
+  absl::StatusOr<Solution> Search() {
     // If multiple heuristics were specified, use round robin to try them all.
     if (params_.preordering_heuristics.size() > 1) return RoundRobin();
     PreorderingComparator preordering_comparator(
         params_.preordering_heuristics.back());
-    for (const Partition& partition : sweep_result_.partitions) {
-      absl::Status status = SubSolve(partition, preordering_comparator);
+    for (int p_idx = 0; p_idx < sweep_result_.partitions.size(); ++p_idx) {
+      absl::Status status = SolvePartition(p_idx, preordering_comparator);
       if (!status.ok()) return status;
     }
     return solution_;
   }
 
- private:
   absl::StatusOr<Solution> RoundRobin() {
     // We'll start with a conservative node limit (in the hopes that one of
     // them will finish quickly), then progressively increase this threshold.
@@ -125,8 +415,9 @@ class SolverImpl {
         PreorderingComparator preordering_comparator(heuristic);
         nodes_remaining_ = node_limit;
         status = absl::OkStatus();
-        for (const Partition& partition : sweep_result_.partitions) {
-          status = SubSolve(partition, preordering_comparator);
+        solved_shapes_.clear();  // Only reuse partitions from this attempt.
+        for (int p_idx = 0; p_idx < sweep_result_.partitions.size(); ++p_idx) {
+          status = SolvePartition(p_idx, preordering_comparator);
           // The 'aborted' code means this strategy exhausted its node limit.
           if (status.code() == absl::StatusCode::kAborted) break;
           if (!status.ok()) return status;
@@ -138,25 +429,30 @@ class SolverImpl {
     return solution_;
   }
 
-  // Prepopulates section data for this partition, then kicks into the recursive
-  // depth-first search.  Returns 'true' if a feasible solution has been found,
-  // otherwise 'false'.
-  absl::Status SubSolve(
-      const Partition& partition,
-      const PreorderingComparator& preordering_comparator) {
+  // Builds a range-maximum structure over the current section totals.
+  RangeMax CreateRangeMax(const SectionRange& section_range) const {
+    std::vector<int64_t> totals;
+    totals.reserve(section_range.upper() - section_range.lower());
+    for (SectionIdx s_idx = section_range.lower();
+        s_idx < section_range.upper(); ++s_idx) {
+      totals.push_back(section_data_[s_idx].total);
+    }
+    return RangeMax(section_range.lower(), std::move(totals));
+  }
+
+  // Gathers the data used to statically preorder the buffers of a partition.
+  std::vector<PreorderData> ComputePreordering(
+      const Partition& partition, const RangeMax& section_totals) const {
     std::vector<PreorderData> preordering;
     preordering.reserve(partition.buffer_idxs.size());
     for (const BufferIdx buffer_idx : partition.buffer_idxs) {
       const Buffer& buffer = problem_.buffers[buffer_idx];
-      int total = 0;
+      int64_t total = 0;
       const BufferData& buffer_data = sweep_result_.buffer_data[buffer_idx];
       const std::vector<SectionSpan>& section_spans = buffer_data.section_spans;
       for (const SectionSpan& section_span : section_spans) {
-        const SectionRange& section_range = section_span.section_range;
-        for (SectionIdx s_idx = section_range.lower();
-            s_idx < section_range.upper(); ++s_idx) {
-          total = std::max(total, section_data_[s_idx].total);
-        }
+        total = std::max(total,
+                         section_totals.Query(section_span.section_range));
       }
       int sections = section_spans.back().section_range.upper() -
                      section_spans.front().section_range.lower();
@@ -171,32 +467,529 @@ class SolverImpl {
         .width = buffer.lifespan.upper() - buffer.lifespan.lower(),
         .buffer_idx = buffer_idx});
     }
+    return preordering;
+  }
+
+  // Describes a partition relative to its earliest start time, with its buffers
+  // listed in a canonical order, such that partitions with equal keys are the
+  // same subproblem shifted in time (and their buffers correspond by position).
+  struct PartitionShape {
+    std::vector<int64_t> key;
+    std::vector<BufferIdx> buffer_idxs;
+  };
+
+  PartitionShape ComputeShape(const Partition& partition) const {
+    TimeValue start = std::numeric_limits<TimeValue>::max();
+    for (const BufferIdx buffer_idx : partition.buffer_idxs) {
+      start = std::min(start, problem_.buffers[buffer_idx].lifespan.lower());
+    }
+    constexpr int64_t kNoValue = std::numeric_limits<int64_t>::min();
+    absl::flat_hash_map<BufferIdx, std::vector<int64_t>> descriptions;
+    for (const BufferIdx buffer_idx : partition.buffer_idxs) {
+      const Buffer& buffer = problem_.buffers[buffer_idx];
+      std::vector<int64_t>& words = descriptions[buffer_idx];
+      words = {buffer.lifespan.lower() - start, buffer.lifespan.upper() - start,
+               buffer.size, buffer.alignment, buffer.offset.value_or(kNoValue),
+               buffer.hint.value_or(kNoValue),
+               static_cast<int64_t>(buffer.gaps.size())};
+      for (const Gap& gap : buffer.gaps) {
+        words.push_back(gap.lifespan.lower() - start);
+        words.push_back(gap.lifespan.upper() - start);
+        words.push_back(gap.window ? gap.window->lower() : kNoValue);
+        words.push_back(gap.window ? gap.window->upper() : kNoValue);
+      }
+    }
+    PartitionShape shape = {.buffer_idxs = partition.buffer_idxs};
+    absl::c_stable_sort(shape.buffer_idxs,
+                        [&descriptions](BufferIdx a, BufferIdx b) {
+                          return descriptions[a] < descriptions[b];
+                        });
+    for (const BufferIdx buffer_idx : shape.buffer_idxs) {
+      const std::vector<int64_t>& words = descriptions[buffer_idx];
+      shape.key.insert(shape.key.end(), words.begin(), words.end());
+    }
+    return shape;
+  }
+
+  // Extracts a partition (in the order given by its shape) as a standalone
+  // problem that begins at time zero.
+  Problem ExtractPartition(const PartitionShape& shape) const {
+    TimeValue start = std::numeric_limits<TimeValue>::max();
+    for (const BufferIdx buffer_idx : shape.buffer_idxs) {
+      start = std::min(start, problem_.buffers[buffer_idx].lifespan.lower());
+    }
+    Problem problem = {.capacity = problem_.capacity};
+    problem.buffers.reserve(shape.buffer_idxs.size());
+    for (const BufferIdx buffer_idx : shape.buffer_idxs) {
+      Buffer buffer = problem_.buffers[buffer_idx];
+      buffer.id.clear();
+      buffer.lifespan = {buffer.lifespan.lower() - start,
+                         buffer.lifespan.upper() - start};
+      for (Gap& gap : buffer.gaps) {
+        gap.lifespan = {gap.lifespan.lower() - start,
+                        gap.lifespan.upper() - start};
+      }
+      problem.buffers.push_back(std::move(buffer));
+    }
+    return problem;
+  }
+
+  // Solves a partition, unless the same shape has already been solved (in
+  // which case its offsets are copied) or is found in the partition cache.
+  absl::Status SolvePartition(
+      int p_idx, const PreorderingComparator& preordering_comparator) {
+    const Partition& partition = sweep_result_.partitions[p_idx];
+    if (!params_.deduplicate_partitions || partition.buffer_idxs.size() < 2) {
+      return SubSolve(partition, preorderings_[p_idx], preordering_comparator);
+    }
+    PartitionShape shape = ComputeShape(partition);
+    if (const auto it = solved_shapes_.find(shape.key);
+        it != solved_shapes_.end()) {
+      for (int idx = 0; idx < shape.buffer_idxs.size(); ++idx) {
+        solution_.offsets[shape.buffer_idxs[idx]] =
+            solution_.offsets[it->second[idx]];
+      }
+      ++stats_.reused_partitions;
+      return absl::OkStatus();
+    }
+    const bool use_cache = partition_cache_ &&
+        partition.buffer_idxs.size() >= kMinCachedPartitionSize;
+    std::optional<Problem> subproblem;
+    if (use_cache) {
+      subproblem = ExtractPartition(shape);
+      const absl::StatusOr<Solution> cached =
+          partition_cache_->Lookup(*subproblem, params_);
+      if (cached.ok()) {
+        for (int idx = 0; idx < shape.buffer_idxs.size(); ++idx) {
+          solution_.offsets[shape.buffer_idxs[idx]] = cached->offsets[idx];
+        }
+        ++stats_.reused_partitions;
+        solved_shapes_.emplace(std::move(shape.key),
+                               std::move(shape.buffer_idxs));
+        return absl::OkStatus();
+      }
+    }
+    absl::Status status =
+        SubSolve(partition, preorderings_[p_idx], preordering_comparator);
+    if (!status.ok()) return status;
+    if (use_cache) {
+      Solution solution;
+      solution.offsets.reserve(shape.buffer_idxs.size());
+      for (const BufferIdx buffer_idx : shape.buffer_idxs) {
+        solution.offsets.push_back(solution_.offsets[buffer_idx]);
+      }
+      // A failure to populate the cache shouldn't fail the solve itself.
+      partition_cache_->Store(*subproblem, params_, solution).IgnoreError();
+    }
+    solved_shapes_.emplace(std::move(shape.key), std::move(shape.buffer_idxs));
+    return absl::OkStatus();
+  }
+
+  // Sorts the preordering for this partition, then kicks into the recursive
+  // depth-first search.  Returns 'true' if a feasible solution has been found,
+  // otherwise 'false'.
+  absl::Status SubSolve(
+      const Partition& partition,
+      std::vector<PreorderData> preordering,
+      const PreorderingComparator& preordering_comparator) {
     if (params_.static_preordering) {
       absl::c_sort(preordering, preordering_comparator);
     }
-    std::vector<OrderData> ordering(preordering.size());
+    const SectionRange& section_range = partition.section_range;
+    if (params_.small_partition_search &&
+        preordering.size() <= kMaxSmallPartitionSize &&
+        section_range.upper() - section_range.lower() <=
+            kMaxSmallPartitionSections) {
+      return SolveSmallPartition(partition, preordering,
+                                 preordering_comparator);
+    }
+    std::vector<OrderData<OffsetT>> ordering(preordering.size());
     for (PreorderIdx idx = 0; idx < preordering.size(); ++idx) {
       ordering[idx].preorder_idx = idx;
     }
+    // Any sub-partitions found by decomposition share the bitsets built here.
+    const bool dense = params_.dense_overlaps && !dense_active_ &&
+                       UseDenseOverlaps(partition);
+    if (dense) BuildDenseOverlaps(partition);
     absl::StatusCode status_code =
         SearchSolutions(partition, preordering_comparator, preordering,
             ordering, /*min_offset=*/0, /*min_preorder_idx=*/0);
+    if (dense) ClearDenseOverlaps();
     return status_code == absl::StatusCode::kOk ? absl::OkStatus()
         : absl::Status(status_code, "Error encountered during search.");
   }
 
+  // Returns whether a partition is large & dense enough that its overlaps are
+  // better scanned as bitsets than as lists.
+  bool UseDenseOverlaps(const Partition& partition) const {
+    const int64_t num_buffers = partition.buffer_idxs.size();
+    if (num_buffers < kMinDenseOverlapsSize ||
+        num_buffers > kMaxDenseOverlapsSize) {
+      return false;
+    }
+    int64_t num_overlaps = 0;
+    for (const BufferIdx buffer_idx : partition.buffer_idxs) {
+      num_overlaps += overlaps_[buffer_idx].size();
+    }
+    return num_overlaps * kDenseOverlapsRatio >= num_buffers * num_buffers;
+  }
+
+  // Builds the bitsets of a partition's overlaps, in which every buffer starts
+  // out unplaced.  Overlaps with buffers outside the partition are left out,
+  // since those buffers have already been placed.
+  void BuildDenseOverlaps(const Partition& partition) {
+    using Word = typename DenseOverlaps<IdxT, OffsetT>::Word;
+    constexpr int kWordBits = DenseOverlaps<IdxT, OffsetT>::kWordBits;
+    DenseOverlaps<IdxT, OffsetT>& dense = dense_overlaps_;
+    const int num_buffers = partition.buffer_idxs.size();
+    const int num_words = (num_buffers + kWordBits - 1) / kWordBits;
+    dense.num_words = num_words;
+    dense.buffer_idxs.assign(partition.buffer_idxs.begin(),
+                             partition.buffer_idxs.end());
+    dense.rows.assign(num_buffers * num_words, 0);
+    dense.ranks.resize(num_buffers * num_words);
+    dense.effective_sizes.clear();
+    dense.unplaced.assign(num_words, 0);
+    for (int pos = 0; pos < num_buffers; ++pos) {
+      dense_positions_[dense.buffer_idxs[pos]] = pos;
+      dense.unplaced[pos / kWordBits] |= Word{1} << (pos % kWordBits);
+    }
+    std::vector<OffsetT> row_sizes(num_buffers);
+    for (int pos = 0; pos < num_buffers; ++pos) {
+      Word* const row = &dense.rows[pos * num_words];
+      for (const auto [other_idx, effective_size] :
+           overlaps_[dense.buffer_idxs[pos]]) {
+        const int other_pos = dense_positions_[other_idx];
+        if (other_pos < 0) continue;
+        Word& word = row[other_pos / kWordBits];
+        const Word bit = Word{1} << (other_pos % kWordBits);
+        // A pair may overlap more than once (around gaps); keep the largest.
+        row_sizes[other_pos] = (word & bit)
+            ? std::max(row_sizes[other_pos], effective_size) : effective_size;
+        word |= bit;
+      }
+      for (int w_idx = 0; w_idx < num_words; ++w_idx) {
+        dense.ranks[pos * num_words + w_idx] = dense.effective_sizes.size();
+        for (Word bits = row[w_idx]; bits; bits &= bits - 1) {
+          dense.effective_sizes.push_back(
+              row_sizes[w_idx * kWordBits + std::countr_zero(bits)]);
+        }
+      }
+    }
+    dense_active_ = true;
+  }
+
+  // Marks the partition's buffers as no longer tracked in bitsets.
+  void ClearDenseOverlaps() {
+    for (const IdxT buffer_idx : dense_overlaps_.buffer_idxs) {
+      dense_positions_[buffer_idx] = -1;
+    }
+    dense_active_ = false;
+  }
+
+  // Flips whether a buffer is unplaced in the dense overlaps (if active).
+  void ToggleDenseUnplaced(BufferIdx buffer_idx) {
+    using Word = typename DenseOverlaps<IdxT, OffsetT>::Word;
+    constexpr int kWordBits = DenseOverlaps<IdxT, OffsetT>::kWordBits;
+    if (!dense_active_) return;
+    const int pos = dense_positions_[buffer_idx];
+    dense_overlaps_.unplaced[pos / kWordBits] ^= Word{1} << (pos % kWordBits);
+  }
+
+  // Calls 'visit' with each unplaced buffer overlapping the given one (and its
+  // effective size), by intersecting the buffer's row with the unplaced set.
+  template <typename Visitor>
+  void VisitDenseOverlaps(BufferIdx buffer_idx, Visitor visit) const {
+    using Word = typename DenseOverlaps<IdxT, OffsetT>::Word;
+    constexpr int kWordBits = DenseOverlaps<IdxT, OffsetT>::kWordBits;
+    const DenseOverlaps<IdxT, OffsetT>& dense = dense_overlaps_;
+    const int64_t row_idx = dense_positions_[buffer_idx] * dense.num_words;
+    const Word* const row = &dense.rows[row_idx];
+    for (int w_idx = 0; w_idx < dense.num_words; ++w_idx) {
+      for (Word bits = row[w_idx] & dense.unplaced[w_idx]; bits;
+           bits &= bits - 1) {
+        const int bit = std::countr_zero(bits);
+        const int64_t rank = dense.ranks[row_idx + w_idx] +
+            std::popcount(row[w_idx] & ((Word{1} << bit) - 1));
+        visit(dense.buffer_idxs[w_idx * kWordBits + bit],
+              dense.effective_sizes[rank]);
+      }
+    }
+  }
+
+  // Solves a partition of a few buffers (given in preorder, and beginning from
+  // their current minimum offsets) by the same search as SearchSolutions, but
+  // whose state is kept in fixed-size arrays rather than on the heap.  Its only
+  // omission is the unallocated floor, which never prunes a feasible subtree,
+  // so it finds the same solution (though it may visit more nodes to do so).
+  absl::Status SolveSmallPartition(
+      const Partition& partition,
+      const std::vector<PreorderData>& preordering,
+      const PreorderingComparator& preordering_comparator) {
+    const SectionRange& section_range = partition.section_range;
+    SmallPartition<OffsetT> small = {
+        .num_buffers = static_cast<int>(preordering.size()),
+        .first_section = section_range.lower(),
+        .num_sections = section_range.upper() - section_range.lower()};
+    for (int idx = 0; idx < small.num_sections; ++idx) {
+      small.floors[idx] = section_data_[small.first_section + idx].floor;
+      small.totals[idx] = section_data_[small.first_section + idx].total;
+    }
+    const auto position = [&small](BufferIdx buffer_idx) {
+      for (int pos = 0; pos < small.num_buffers; ++pos) {
+        if (small.buffer_idxs[pos] == buffer_idx) return pos;
+      }
+      return -1;
+    };
+    for (int pos = 0; pos < small.num_buffers; ++pos) {
+      small.buffer_idxs[pos] = preordering[pos].buffer_idx;
+    }
+    for (int pos = 0; pos < small.num_buffers; ++pos) {
+      const BufferIdx buffer_idx = small.buffer_idxs[pos];
+      small.min_offsets[pos] = min_offsets_[buffer_idx];
+      small.sizes[pos] = buffer_table_.sizes[buffer_idx];
+      small.alignments[pos] = buffer_table_.alignments[buffer_idx];
+      small.fixed_offsets[pos] = buffer_table_.fixed_offsets[buffer_idx];
+      small.previous[pos] = Enabled(kBreakSymmetries)
+          ? position(previous_equivalents_[buffer_idx]) : -1;
+      small.overlaps[pos] = 0;
+      // Any overlapping buffer outside the partition has already been placed.
+      for (const auto [other_idx, effective_size] : overlaps_[buffer_idx]) {
+        const int other_pos = position(other_idx);
+        if (other_pos < 0) continue;
+        small.overlaps[pos] |= typename SmallPartition<OffsetT>::Mask{1}
+                               << other_pos;
+        small.effective_sizes[pos][other_pos] = effective_size;
+      }
+    }
+    const absl::StatusCode status_code =
+        SearchSmallPartition(small, preordering_comparator, /*placed=*/0,
+                             /*min_offset=*/0, /*min_pos=*/0);
+    return status_code == absl::StatusCode::kOk ? absl::OkStatus()
+        : absl::Status(status_code, "Error encountered during search.");
+  }
+
+  // The recursive search behind SolveSmallPartition, which places one buffer
+  // at a time at its lowest viable offset.  The 'placed' mask holds the
+  // positions of any buffers placed so far.
+  absl::StatusCode SearchSmallPartition(
+      SmallPartition<OffsetT>& small,
+      const PreorderingComparator& preordering_comparator,
+      typename SmallPartition<OffsetT>::Mask placed,
+      OffsetT min_offset,
+      int min_pos) {
+    using Mask = typename SmallPartition<OffsetT>::Mask;
+    if (nodes_remaining_ <= 0) return absl::StatusCode::kAborted;
+    --nodes_remaining_;
+    ++stats_.nodes;
+    if (absl::Now() - start_time_ > params_.timeout ||
+        context_.is_cancelled()) {
+      return absl::StatusCode::kDeadlineExceeded;
+    }
+    if (placed == (Mask{1} << small.num_buffers) - 1) {
+      for (int pos = 0; pos < small.num_buffers; ++pos) {
+        solution_.offsets[small.buffer_idxs[pos]] = small.offsets[pos];
+      }
+      return absl::StatusCode::kOk;  // We've reached a leaf node.
+    }
+    // Find the lowest viable offset of each unplaced buffer.
+    std::array<OrderData<OffsetT>, SmallPartition<OffsetT>::kSize> ordering;
+    int num_unplaced = 0;
+    OffsetT min_height = std::numeric_limits<OffsetT>::max();
+    for (int pos = 0; pos < small.num_buffers; ++pos) {
+      if (placed & (Mask{1} << pos)) continue;
+      const OffsetT offset = SmallMinOffset(small, placed, pos);
+      ordering[num_unplaced++] = {.offset = offset, .preorder_idx = pos};
+      min_height = std::min(min_height, offset + small.sizes[pos]);
+    }
+    if (Enabled(kDynamicOrdering)) {
+      std::sort(ordering.begin(), ordering.begin() + num_unplaced,
+                kDynamicComparator);
+    }
+    for (int idx = 0; idx < num_unplaced; ++idx) {
+      const auto [offset, pos] = ordering[idx];
+      if (Enabled(kCanonicalOnly)) {
+        if (offset < min_offset || (offset == min_offset && pos < min_pos)) {
+          continue;
+        }
+      }
+      if (Enabled(kCheckDominance) && offset >= min_height) continue;
+      if (offset > small.fixed_offsets[pos]) continue;
+      if (const int previous_pos = small.previous[pos];
+          previous_pos >= 0 && !(placed & (Mask{1} << previous_pos))) {
+        continue;
+      }
+      small.offsets[pos] = offset;
+      const typename SmallPartition<OffsetT>::SectionArray floors =
+          small.floors, totals = small.totals;
+      absl::StatusCode status_code = absl::StatusCode::kNotFound;
+      if (!SmallFixedOffsetFailure(small, placed, pos, offset) &&
+          UpdateSmallSections(small, pos, offset)) {
+        status_code = Enabled(kDynamicDecomposition)
+            ? DecomposeSmallPartition(small, preordering_comparator,
+                                      placed | Mask{1} << pos, offset, pos)
+            : SearchSmallPartition(small, preordering_comparator,
+                                   placed | Mask{1} << pos, offset, pos);
+      }
+      small.floors = floors;
+      small.totals = totals;
+      if (status_code != absl::StatusCode::kNotFound) return status_code;
+      if (Enabled(kHatlessPruning) && !(small.overlaps[pos] & ~placed)) break;
+    }
+    ++stats_.backtracks;
+    return absl::StatusCode::kNotFound;  // No feasible solution found.
+  }
+
+  // Returns the lowest viable offset of the unplaced buffer at 'pos', given the
+  // buffers placed so far.
+  OffsetT SmallMinOffset(const SmallPartition<OffsetT>& small,
+                         typename SmallPartition<OffsetT>::Mask placed,
+                         int pos) const {
+    OffsetT offset = small.min_offsets[pos];
+    for (auto below = small.overlaps[pos] & placed; below; below &= below - 1) {
+      const int other_pos = std::countr_zero(below);
+      const OffsetT height =
+          small.offsets[other_pos] + small.effective_sizes[other_pos][pos];
+      if (offset < height) offset = AlignUp(height, small.alignments[pos]);
+    }
+    return offset;
+  }
+
+  // Returns true if placing the buffer at 'pos' at the given offset would raise
+  // the minimum offset of an unplaced neighbor above its fixed offset (as with
+  // the fixed_offset_failure of UpdateMinOffsets).
+  bool SmallFixedOffsetFailure(const SmallPartition<OffsetT>& small,
+                               typename SmallPartition<OffsetT>::Mask placed,
+                               int pos, OffsetT offset) const {
+    const auto unplaced = small.overlaps[pos] & ~placed;
+    for (auto above = unplaced; above; above &= above - 1) {
+      const int other_pos = std::countr_zero(above);
+      const OffsetT height = offset + small.effective_sizes[pos][other_pos];
+      if (AlignUp(height, small.alignments[other_pos]) >
+              small.fixed_offsets[other_pos] &&
+          SmallMinOffset(small, placed, other_pos) < height) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Decomposes a small partition (as DynamicallyDecompose does) given that the
+  // buffer at 'pos' was the latest to be placed.  Any sub-partitions are solved
+  // by SubSolve, after the shared section data & minimum offsets are brought up
+  // to date with this partial solution (and they are restored afterward).
+  absl::StatusCode DecomposeSmallPartition(
+      SmallPartition<OffsetT>& small,
+      const PreorderingComparator& preordering_comparator,
+      typename SmallPartition<OffsetT>::Mask placed,
+      OffsetT min_offset,
+      int min_pos) {
+    using Mask = typename SmallPartition<OffsetT>::Mask;
+    const BufferIdx buffer_idx = small.buffer_idxs[min_pos];
+    solution_.offsets[buffer_idx] = min_offset;
+    const SectionIdx lower = small.first_section;
+    const SectionIdx upper = lower + small.num_sections;
+    std::vector<SectionIdx> cutpoints = {lower};
+    const SectionRange& buffer_range = buffer_table_.section_ranges[buffer_idx];
+    for (SectionIdx s_idx = buffer_range.lower();
+      s_idx + 1 < buffer_range.upper(); ++s_idx) {
+      if (--cuts_[s_idx] == 0) cutpoints.push_back(s_idx + 1);
+    }
+    absl::StatusCode status_code = absl::StatusCode::kOk;
+    if (cutpoints.size() == 1) {
+      status_code = SearchSmallPartition(small, preordering_comparator, placed,
+                                         min_offset, min_pos);
+    } else {
+      cutpoints.push_back(upper);
+      std::array<SectionData<OffsetT>, kMaxSmallPartitionSections> sections;
+      for (int idx = 0; idx < small.num_sections; ++idx) {
+        sections[idx] = section_data_[lower + idx];
+        section_data_[lower + idx] = {.floor = small.floors[idx],
+                                      .total = small.totals[idx]};
+      }
+      for (int pos = 0; pos < small.num_buffers; ++pos) {
+        if (placed & (Mask{1} << pos)) continue;
+        min_offsets_[small.buffer_idxs[pos]] =
+            SmallMinOffset(small, placed, pos);
+      }
+      for (int c_idx = 1; c_idx < cutpoints.size(); ++c_idx) {
+        const SectionRange section_range =
+            {cutpoints[c_idx - 1], cutpoints[c_idx]};
+        std::vector<BufferIdx> buffer_idxs;
+        for (int pos = 0; pos < small.num_buffers; ++pos) {
+          if (placed & (Mask{1} << pos)) continue;
+          const BufferIdx other_idx = small.buffer_idxs[pos];
+          const SectionRange& other_range =
+              buffer_table_.section_ranges[other_idx];
+          if (!(other_range.upper() <= section_range.lower() ||
+                section_range.upper() <= other_range.lower())) {
+            buffer_idxs.push_back(other_idx);
+          }
+        }
+        if (buffer_idxs.empty()) continue;
+        const Partition sub_partition =
+            {.buffer_idxs = buffer_idxs, .section_range = section_range};
+        absl::Status status = SubSolve(sub_partition,
+            ComputePreordering(sub_partition, CreateRangeMax(section_range)),
+            preordering_comparator);
+        if (!status.ok()) {
+          status_code = status.code();
+          break;
+        }
+      }
+      for (int pos = 0; pos < small.num_buffers; ++pos) {
+        const BufferIdx other_idx = small.buffer_idxs[pos];
+        if (!(placed & (Mask{1} << pos))) {
+          min_offsets_[other_idx] = small.min_offsets[pos];
+        }
+      }
+      for (int idx = 0; idx < small.num_sections; ++idx) {
+        section_data_[lower + idx] = sections[idx];
+      }
+    }
+    for (SectionIdx s_idx = buffer_range.lower();
+        s_idx + 1 < buffer_range.upper(); ++s_idx) {
+      ++cuts_[s_idx];
+    }
+    return status_code;
+  }
+
+  // Updates a small partition's section data (as UpdateSectionData does) given
+  // that the buffer at 'pos' is the next to be placed, then checks it (as Check
+  // does).  Returns 'false' if this partial solution should be pruned.
+  bool UpdateSmallSections(SmallPartition<OffsetT>& small, int pos,
+                           OffsetT offset) {
+    for (const SectionSpan& section_span :
+         GetSectionSpans(small.buffer_idxs[pos])) {
+      const SectionRange& section_range = section_span.section_range;
+      const Window& window = section_span.window;
+      for (SectionIdx s_idx = section_range.lower();
+          s_idx < section_range.upper(); ++s_idx) {
+        small.floors[s_idx - small.first_section] = offset + window.upper();
+        small.totals[s_idx - small.first_section] -=
+            window.upper() - window.lower();
+      }
+    }
+    for (int idx = 0; idx < small.num_sections; ++idx) {
+      OffsetT floor = small.floors[idx];
+      if (Enabled(kMonotonicFloor)) floor = std::max(offset, floor);
+      if (Enabled(kSectionInference)) floor += small.totals[idx];
+      if (problem_.capacity < floor) return false;
+    }
+    return true;
+  }
+
   // Updates section data given that 'buffer_idx' is the next item to be placed.
-  std::vector<SectionChange> UpdateSectionData(
-      const absl::flat_hash_set<SectionIdx>& affected_sections,
+  std::vector<SectionChange<OffsetT>> UpdateSectionData(
+      const std::vector<SectionIdx>& affected_sections,
       BufferIdx buffer_idx) {
-    std::vector<SectionChange> section_changes;
-    const Offset offset = assignment_.offsets[buffer_idx];
+    std::vector<SectionChange<OffsetT>> section_changes;
+    const OffsetT offset = assignment_[buffer_idx];
     // For any section this buffer resides in, bump up the floor & drop the sum.
-    const BufferData& buffer_data = sweep_result_.buffer_data[buffer_idx];
-    for (const SectionSpan& section_span : buffer_data.section_spans) {
+    for (const SectionSpan& section_span : GetSectionSpans(buffer_idx)) {
       const SectionRange& section_range = section_span.section_range;
       const Window& window = section_span.window;
-      const Offset height = offset + window.upper();
+      const OffsetT height = offset + window.upper();
       for (SectionIdx s_idx = section_range.lower();
           s_idx < section_range.upper(); ++s_idx) {
         section_changes.push_back(
@@ -207,13 +1000,16 @@ class SolverImpl {
     }
     // The floor of any section cannot be lower than its lowest minimum offset.
     for (const SectionIdx s_idx : affected_sections) {
-      Offset min_offset = INT_MAX;
-      for (const BufferIdx other_idx : sweep_result_.sections[s_idx]) {
-        if (assignment_.offsets[other_idx] == kNoOffset) {
+      OffsetT min_offset = std::numeric_limits<OffsetT>::max();
+      for (int64_t idx = section_starts_[s_idx];
+           idx < section_starts_[s_idx + 1]; ++idx) {
+        const IdxT other_idx = section_members_[idx];
+        if (assignment_[other_idx] == kNoOffset) {
           min_offset = std::min(min_offset, min_offsets_[other_idx]);
         }
       }
-      if (min_offset != INT_MAX && section_data_[s_idx].floor < min_offset) {
+      if (min_offset != std::numeric_limits<OffsetT>::max() &&
+          section_data_[s_idx].floor < min_offset) {
         section_changes.push_back(
             {.section_idx = s_idx, .floor = section_data_[s_idx].floor});
         section_data_[s_idx].floor = min_offset;
@@ -224,14 +1020,13 @@ class SolverImpl {
 
   // Restores the section data by reversing any recorded changes.
   void RestoreSectionData(
-      const std::vector<SectionChange>& section_changes,
+      const std::vector<SectionChange<OffsetT>>& section_changes,
       BufferIdx buffer_idx) {
     for (auto c = section_changes.rbegin(); c != section_changes.rend(); ++c) {
       section_data_[c->section_idx].floor = c->floor;
     }
     // For any section this buffer resides in, increase the sum.
-    const BufferData& buffer_data = sweep_result_.buffer_data[buffer_idx];
-    for (const SectionSpan& section_span : buffer_data.section_spans) {
+    for (const SectionSpan& section_span : GetSectionSpans(buffer_idx)) {
       const SectionRange& section_range = section_span.section_range;
       const Window& window = section_span.window;
       for (SectionIdx s_idx = section_range.lower();
@@ -242,47 +1037,51 @@ class SolverImpl {
   }
 
   // Updates min offset data, given that 'buffer_idx' is the next to be placed.
-  std::optional<std::vector<OffsetChange>> UpdateMinOffsets(
+  std::optional<std::vector<OffsetChange<IdxT, OffsetT>>> UpdateMinOffsets(
       BufferIdx buffer_idx,
-      absl::flat_hash_set<SectionIdx>& affected_sections,
+      std::vector<SectionIdx>& affected_sections,
       bool& fixed_offset_failure) {
     bool hatless = true;
-    std::vector<OffsetChange> offset_changes;
-    const Offset offset = assignment_.offsets[buffer_idx];
-    // For any overlap this buffer participates in, bump up its minimum offset.
-    const std::vector<BufferData>& buffer_data = sweep_result_.buffer_data;
-    for (const Overlap& overlap : buffer_data[buffer_idx].overlaps) {
-      const BufferIdx other_idx = overlap.buffer_idx;
-      if (assignment_.offsets[other_idx] != kNoOffset) continue;
+    std::vector<OffsetChange<IdxT, OffsetT>> offset_changes;
+    const OffsetT offset = assignment_[buffer_idx];
+    // For any overlap with an unallocated buffer, bump up its minimum offset.
+    const auto update = [&](IdxT other_idx, OffsetT effective_size) {
       hatless = false;
-      const Offset height = offset + overlap.effective_size;
-      if (min_offsets_[other_idx] >= height) continue;
+      const OffsetT height = offset + effective_size;
+      if (min_offsets_[other_idx] >= height) return;
       offset_changes.push_back(
           {.buffer_idx = other_idx, .min_offset = min_offsets_[other_idx]});
-      min_offsets_[other_idx] = height;
-      const Buffer& other_buffer = problem_.buffers[other_idx];
-      Offset diff = min_offsets_[other_idx] % other_buffer.alignment;
-      if (diff > 0) min_offsets_[other_idx] += other_buffer.alignment - diff;
-      if (other_buffer.offset &&
-          min_offsets_[other_idx] > *other_buffer.offset) {
+      min_offsets_[other_idx] =
+          AlignUp(height, buffer_table_.alignments[other_idx]);
+      if (min_offsets_[other_idx] > buffer_table_.fixed_offsets[other_idx]) {
         fixed_offset_failure = true;
       }
-      if (!params_.unallocated_floor) continue;  // Mutation safe.
-      const BufferData& buffer_data = sweep_result_.buffer_data[other_idx];
-      for (const SectionSpan& section_span : buffer_data.section_spans) {
+      if (!Enabled(kUnallocatedFloor)) return;  // Mutation safe.
+      for (const SectionSpan& section_span : GetSectionSpans(other_idx)) {
         const SectionRange& section_range = section_span.section_range;
         for (SectionIdx s_idx = section_range.lower();
              s_idx < section_range.upper(); ++s_idx) {
-          affected_sections.insert(s_idx);
+          if (section_stamps_[s_idx] == stamp_) continue;
+          section_stamps_[s_idx] = stamp_;
+          affected_sections.push_back(s_idx);
         }
       }
+    };
+    if (dense_active_) {
+      VisitDenseOverlaps(buffer_idx, update);
+    } else {
+      for (const auto [other_idx, effective_size] : overlaps_[buffer_idx]) {
+        if (assignment_[other_idx] != kNoOffset) continue;
+        update(other_idx, effective_size);
+      }
     }
     if (hatless) return std::nullopt;
     return offset_changes;
   }
 
   // Restores the minimum offsets by reversing any recorded changes.
-  void RestoreMinOffsets(const std::vector<OffsetChange>& offset_changes) {
+  void RestoreMinOffsets(
+      const std::vector<OffsetChange<IdxT, OffsetT>>& offset_changes) {
     for (auto c = offset_changes.rbegin(); c != offset_changes.rend(); ++c) {
       min_offsets_[c->buffer_idx] = c->min_offset;
     }
@@ -290,14 +1089,14 @@ class SolverImpl {
 
   // Returns 'true' if this partial solution satisfies consistency & inference
   // checks, otherwise 'false'.
-  bool Check(const Partition& partition, Offset offset) {
+  bool Check(const Partition& partition, OffsetT offset) {
     for (SectionIdx s_idx = partition.section_range.lower();
         s_idx < partition.section_range.upper(); ++s_idx) {
       // Note: by construction, the given section_data object is guaranteed to
       // have an element for every index in the partition's section_range.
       auto [floor, total] = section_data_[s_idx];
-      if (params_.monotonic_floor) floor = std::max(offset, floor);
-      if (params_.section_inference) floor += total;
+      if (Enabled(kMonotonicFloor)) floor = std::max(offset, floor);
+      if (Enabled(kSectionInference)) floor += total;
       if (problem_.capacity < floor) return false;
     }
     return true;
@@ -305,32 +1104,32 @@ class SolverImpl {
 
   // Orders unallocated buffers by their minimum possible offset values, using
   // buffer areas as a tie-breaker.
-  std::vector<OrderData> ComputeOrdering(
+  std::vector<OrderData<OffsetT>> ComputeOrdering(
       const std::vector<PreorderData>& preordering,
-      const std::vector<OrderData>& orig_ordering) {
-    std::vector<OrderData> ordering;
+      const std::vector<OrderData<OffsetT>>& orig_ordering) {
+    std::vector<OrderData<OffsetT>> ordering;
     for (const auto [offset, preorder_idx] : orig_ordering) {
       const BufferIdx buffer_idx = preordering[preorder_idx].buffer_idx;
       // If this buffer has already been assigned, keep looking.
-      if (assignment_.offsets[buffer_idx] != kNoOffset) continue;
-      const Offset new_offset = min_offsets_[buffer_idx];
+      if (assignment_[buffer_idx] != kNoOffset) continue;
+      const OffsetT new_offset = min_offsets_[buffer_idx];
       ordering.push_back(
           {.offset = new_offset, .preorder_idx = preorder_idx});
     }
-    if (params_.dynamic_ordering) absl::c_sort(ordering, kDynamicComparator);
+    if (Enabled(kDynamicOrdering)) absl::c_sort(ordering, kDynamicComparator);
     return ordering;
   }
 
   // Determines the minimum height of any unallocated buffer ... no other buffer
   // should be assigned to an offset at this value or greater.
-  Offset CalcMinHeight(
+  OffsetT CalcMinHeight(
       const std::vector<PreorderData>& preordering,
-      const std::vector<OrderData>& ordering) {
-    Offset min_height = INT_MAX;
+      const std::vector<OrderData<OffsetT>>& ordering) {
+    OffsetT min_height = std::numeric_limits<OffsetT>::max();
     for (const auto [offset, preorder_idx] : ordering) {
       const BufferIdx buffer_idx = preordering[preorder_idx].buffer_idx;
-      const Buffer& buffer = problem_.buffers[buffer_idx];
-      min_height = std::min(min_height, offset + buffer.size);
+      min_height =
+          std::min(min_height, offset + buffer_table_.sizes[buffer_idx]);
     }
     return min_height;
   }
@@ -342,49 +1141,57 @@ class SolverImpl {
       const Partition& partition,
       const PreorderingComparator& preordering_comparator,
       const std::vector<PreorderData>& preordering,
-      const std::vector<OrderData>& orig_ordering,
-      Offset min_offset,
+      const std::vector<OrderData<OffsetT>>& orig_ordering,
+      OffsetT min_offset,
       PreorderIdx min_preorder_idx) {
     if (nodes_remaining_ <= 0) return absl::StatusCode::kAborted;
     --nodes_remaining_;
-    if (absl::Now() - start_time_ > params_.timeout || cancelled_) {
+    ++stats_.nodes;
+    if (absl::Now() - start_time_ > params_.timeout ||
+        context_.is_cancelled()) {
       return absl::StatusCode::kDeadlineExceeded;
     }
-    const std::vector<OrderData> ordering =
+    const std::vector<OrderData<OffsetT>> ordering =
         ComputeOrdering(preordering, orig_ordering);
     if (ordering.empty()) {
       // Store offsets for all the buffers that participate in this partition.
       for (const BufferIdx buffer_idx : partition.buffer_idxs) {
-        solution_.offsets[buffer_idx] = assignment_.offsets[buffer_idx];
+        solution_.offsets[buffer_idx] = assignment_[buffer_idx];
       }
       return absl::StatusCode::kOk;  // We've reached a leaf node.
     }
-    const Offset min_height = CalcMinHeight(preordering, ordering);
+    const OffsetT min_height = CalcMinHeight(preordering, ordering);
     for (const auto [offset, preorder_idx] : ordering) {
       const BufferIdx buffer_idx = preordering[preorder_idx].buffer_idx;
-      if (params_.canonical_only) {
+      if (Enabled(kCanonicalOnly)) {
         // Buffers should be placed in non-increasing order by area.
         if (offset < min_offset ||
             (offset == min_offset && preorder_idx < min_preorder_idx)) continue;
       }
-      if (params_.check_dominance) {
+      if (Enabled(kCheckDominance)) {
        // Check if this solution would introduce an unnecessary gap.
         if (offset >= min_height) continue;
       }
-      if (const Buffer& buffer = problem_.buffers[buffer_idx]; buffer.offset) {
-        if (offset > *buffer.offset) continue;
+      if (offset > buffer_table_.fixed_offsets[buffer_idx]) continue;
+      if (Enabled(kBreakSymmetries)) {
+        // Interchangeable buffers must be placed in order of their index.
+        const BufferIdx previous_idx = previous_equivalents_[buffer_idx];
+        if (previous_idx >= 0 &&
+            assignment_[previous_idx] == kNoOffset) continue;
       }
-      assignment_.offsets[buffer_idx] = offset;
-      absl::flat_hash_set<SectionIdx> affected_sections;
+      assignment_[buffer_idx] = offset;
+      ToggleDenseUnplaced(buffer_idx);
+      std::vector<SectionIdx> affected_sections;
+      ++stamp_;  // Marks the sections affected by this placement.
       bool fixed_offset_failure = false;
       auto offset_changes = UpdateMinOffsets(buffer_idx, affected_sections,
 		                             fixed_offset_failure);
-      std::vector<SectionChange> section_changes =
+      std::vector<SectionChange<OffsetT>> section_changes =
           UpdateSectionData(affected_sections, buffer_idx);
       absl::StatusCode status_code = absl::StatusCode::kNotFound;
       if (!fixed_offset_failure && Check(partition, offset)) {
         status_code =
-            params_.dynamic_decomposition
+            Enabled(kDynamicDecomposition)
                 ? DynamicallyDecompose(partition, preordering_comparator,
                     preordering, ordering, offset, preorder_idx, buffer_idx)
                 : SearchSolutions(partition, preordering_comparator,
@@ -392,12 +1199,13 @@ class SolverImpl {
       }
       RestoreSectionData(section_changes, buffer_idx);
       if (offset_changes) RestoreMinOffsets(*offset_changes);
-      assignment_.offsets[buffer_idx] = kNoOffset;  // Mark it unallocated.
+      assignment_[buffer_idx] = kNoOffset;  // Mark it unallocated.
+      ToggleDenseUnplaced(buffer_idx);
       // If a feasible solution *or* timeout, abort search.
       if (status_code != absl::StatusCode::kNotFound) return status_code;
-      if (!offset_changes && params_.hatless_pruning) break;
+      if (!offset_changes && Enabled(kHatlessPruning)) break;
     }
-    ++backtracks_;
+    ++stats_.backtracks;
     return absl::StatusCode::kNotFound;  // No feasible solution found.
   }
 
@@ -407,18 +1215,17 @@ class SolverImpl {
       const Partition& partition,
       const PreorderingComparator& preordering_comparator,
       const std::vector<PreorderData>& preordering,
-      const std::vector<OrderData>& orig_ordering,
-      Offset min_offset,
+      const std::vector<OrderData<OffsetT>>& orig_ordering,
+      OffsetT min_offset,
       PreorderIdx min_preorder_idx,
       BufferIdx buffer_idx) {
-    solution_.offsets[buffer_idx] = assignment_.offsets[buffer_idx];
+    solution_.offsets[buffer_idx] = assignment_[buffer_idx];
     // Reduce the cuts between sections spanned by this buffer (and store all
     // zero-cut section indices into 'cutpoints', to be solved separately).
     std::vector<SectionIdx> cutpoints = {partition.section_range.lower()};
-    const BufferData& buffer_data = sweep_result_.buffer_data[buffer_idx];
-    const std::vector<SectionSpan>& section_spans = buffer_data.section_spans;
-    for (SectionIdx s_idx = section_spans.front().section_range.lower();
-      s_idx + 1 < section_spans.back().section_range.upper(); ++s_idx) {
+    const SectionRange& buffer_range = buffer_table_.section_ranges[buffer_idx];
+    for (SectionIdx s_idx = buffer_range.lower();
+      s_idx + 1 < buffer_range.upper(); ++s_idx) {
       if (--cuts_[s_idx] == 0) cutpoints.push_back(s_idx + 1);
     }
     absl::StatusCode status_code = absl::StatusCode::kOk;
@@ -436,12 +1243,9 @@ class SolverImpl {
         std::vector<BufferIdx> buffer_idxs;
         for (const BufferIdx other_idx : partition.buffer_idxs) {
           // A minor optimization (mutants ok).
-          if (assignment_.offsets[other_idx] != kNoOffset) continue;
-          const BufferData& other_data = sweep_result_.buffer_data[other_idx];
-          const SectionRange other_range = {
-            other_data.section_spans.front().section_range.lower(),
-            other_data.section_spans.back().section_range.upper()
-          };
+          if (assignment_[other_idx] != kNoOffset) continue;
+          const SectionRange& other_range =
+              buffer_table_.section_ranges[other_idx];
           if (!(other_range.upper() <= section_range.lower() ||
                 section_range.upper() <= other_range.lower())) {
             buffer_idxs.push_back(other_idx);
@@ -451,7 +1255,9 @@ class SolverImpl {
         // Create the sub-partition and solve it.
         const Partition sub_partition =
             {.buffer_idxs = buffer_idxs, .section_range = section_range};
-        absl::Status status = SubSolve(sub_partition, preordering_comparator);
+        absl::Status status = SubSolve(sub_partition,
+            ComputePreordering(sub_partition, CreateRangeMax(section_range)),
+            preordering_comparator);
         if (!status.ok()) {
           status_code = status.code();
           break;
@@ -459,8 +1265,8 @@ class SolverImpl {
       }
     }
     // Restore all section cuts to their previous values.
-    for (SectionIdx s_idx = section_spans.front().section_range.lower();
-        s_idx + 1 < section_spans.back().section_range.upper(); ++s_idx) {
+    for (SectionIdx s_idx = buffer_range.lower();
+        s_idx + 1 < buffer_range.upper(); ++s_idx) {
       ++cuts_[s_idx];
     }
     return status_code;
@@ -470,17 +1276,61 @@ class SolverImpl {
   const absl::Time start_time_;
   const Problem& problem_;
   const SweepResult& sweep_result_;
-  int64_t& backtracks_;
-  std::atomic<bool>& cancelled_;
+  SolverStats& stats_;
+  const SolveContext& context_;
+  const SolutionCache* const partition_cache_;
+  const SearchFeatures features_;  // Only consulted for kRuntimeFeatures.
+  const BufferTable<OffsetT> buffer_table_;
 
-  Solution assignment_;
+  std::vector<OffsetT> assignment_;  // The offset of each buffer placed so far.
   Solution solution_;
-  std::vector<Offset> min_offsets_;
-  std::vector<SectionData> section_data_;
+  std::vector<OffsetT> min_offsets_;
+  std::vector<std::vector<CompactOverlap<IdxT, OffsetT>>> overlaps_;
+  std::vector<BufferIdx> previous_equivalents_;  // See FindPreviousEquivalents.
+  std::vector<SectionData<OffsetT>> section_data_;
+  // The buffers of each section s, flattened: section_members_ holds them from
+  // section_starts_[s] up to (but excluding) section_starts_[s + 1].
+  std::vector<int64_t> section_starts_;
+  std::vector<IdxT> section_members_;
+  // The latest placement (by stamp) to affect each section, so that sections
+  // are only gathered once per placement by UpdateMinOffsets.
+  std::vector<int64_t> section_stamps_;
+  int64_t stamp_ = 0;
+  // The overlaps of the partition being solved, if it is dense enough to keep
+  // them as bitsets (see DenseOverlaps), and each of its buffers' positions.
+  DenseOverlaps<IdxT, OffsetT> dense_overlaps_;
+  std::vector<int> dense_positions_;
+  bool dense_active_ = false;
   std::vector<CutCount> cuts_;
+  std::vector<std::vector<PreorderData>> preorderings_;  // One per partition.
+  // The buffers of each partition solved so far, in canonical order by shape.
+  absl::flat_hash_map<std::vector<int64_t>, std::vector<BufferIdx>>
+      solved_shapes_;
   int64_t nodes_remaining_ = std::numeric_limits<int64_t>::max();
 };  // class SolverImpl
 
+// Runs the instantiation of SolverImpl among kConfigs that matches the given
+// features, or the one that consults them at runtime if none does.
+template <typename IdxT, typename OffsetT, const auto& kConfigs,
+          int kConfigIdx = 0>
+absl::StatusOr<Solution> SolveWithFeatures(SearchFeatures features,
+    const SolverParams& params, absl::Time start_time, const Problem& problem,
+    const SweepResult& sweep_result, SolveContext& context,
+    const SolutionCache* partition_cache) {
+  if constexpr (kConfigIdx == kConfigs.size()) {
+    return SolverImpl<IdxT, OffsetT, kRuntimeFeatures>(params, start_time,
+        problem, sweep_result, context, partition_cache, features).Solve();
+  } else {
+    constexpr SearchFeatures kFeatures = kConfigs[kConfigIdx];
+    if (features == kFeatures) {
+      return SolverImpl<IdxT, OffsetT, kFeatures>(params, start_time, problem,
+          sweep_result, context, partition_cache, features).Solve();
+    }
+    return SolveWithFeatures<IdxT, OffsetT, kConfigs, kConfigIdx + 1>(features,
+        params, start_time, problem, sweep_result, context, partition_cache);
+  }
+}
+
 }  // namespace
 
 PreorderingComparator::PreorderingComparator(const PreorderingHeuristic& h) :
@@ -501,34 +1351,74 @@ bool PreorderingComparator::operator()(
   return a.buffer_idx < b.buffer_idx;
 }
 
+void SolveContext::Reset() {
+  stats_ = SolverStats();
+  cancelled_ = false;
+}
+
 Solver::Solver() {}
 
 Solver::Solver(const SolverParams& params) : params_(params) {}
 
+Solver::Solver(const SolverParams& params,
+               const SolutionCache* partition_cache)
+    : params_(params), partition_cache_(partition_cache) {}
+
+absl::StatusOr<Solution> Solver::Solve(const Problem& problem) {
+  context_.Reset();  // Reset the backtrack counter (and others).
+  return Solve(problem, context_);
+}
+
 // Calculates partitions, and then solves each subproblem independently.  If
 // any subproblem is found to be infeasible, no further search is performed.
-absl::StatusOr<Solution> Solver::Solve(const Problem& problem) {
-  backtracks_ = 0;  // Reset the backtrack counter.
-  cancelled_ = false;
-  return SolveWithStartTime(problem, absl::Now());
+absl::StatusOr<Solution> Solver::Solve(const Problem& problem,
+                                       SolveContext& context) const {
+  return SolveWithStartTime(problem, absl::Now(), context);
 }
 
-absl::StatusOr<Solution> Solver::SolveWithStartTime(const Problem& problem,
-                                                    absl::Time start_time) {
-  const SweepResult sweep_result = Sweep(problem);
-  SolverImpl solver_impl(
-      params_, start_time, problem, sweep_result, &backtracks_, cancelled_);
-  return solver_impl.Solve();
+absl::StatusOr<Solution> Solver::SolveWithStartTime(
+    const Problem& problem, absl::Time start_time,
+    SolveContext& context) const {
+  // Solve a scaled-down copy if every size & offset shares a common divisor.
+  std::optional<Problem> scaled_problem;
+  int64_t scale = 1;
+  if (params_.normalize_scale && (scale = ComputeScale(problem)) > 1) {
+    scaled_problem = ScaleDown(problem, scale);
+  }
+  const Problem& target = scaled_problem ? *scaled_problem : problem;
+  const absl::Time sweep_start_time = absl::Now();
+  const SweepResult sweep_result = Sweep(target);
+  context.mutable_stats()->sweep_time += absl::Now() - sweep_start_time;
+  const SearchFeatures features = GetSearchFeatures(params_, sweep_result);
+  absl::StatusOr<Solution> solution =
+      FitsInt32(target)
+          ? SolveWithFeatures<int32_t, int32_t, kSpecializedFeatures>(
+                features, params_, start_time, target, sweep_result, context,
+                partition_cache_)
+          : SolveWithFeatures<int64_t, int64_t, kWideSpecializedFeatures>(
+                features, params_, start_time, target, sweep_result, context,
+                partition_cache_);
+  if (solution.ok() && scale > 1) {
+    for (Offset& offset : solution->offsets) offset *= scale;
+  }
+  return solution;
 }
 
-int64_t Solver::get_backtracks() const { return backtracks_; }
+int64_t Solver::get_backtracks() const { return get_stats().backtracks; }
 
-void Solver::Cancel() { cancelled_ = true; }
+const SolverStats& Solver::get_stats() const { return context_.get_stats(); }
+
+void Solver::Cancel() { context_.Cancel(); }
 
 absl::StatusOr<std::vector<BufferIdx>>
     Solver::ComputeIrreducibleInfeasibleSubset(const Problem& problem) {
-  backtracks_ = 0;  // Reset the backtrack counter.
-  cancelled_ = false;
+  context_.Reset();  // Reset the backtrack counter (and others).
+  return ComputeIrreducibleInfeasibleSubset(problem, context_);
+}
+
+absl::StatusOr<std::vector<BufferIdx>>
+    Solver::ComputeIrreducibleInfeasibleSubset(const Problem& problem,
+                                               SolveContext& context) const {
   const absl::Time start_time = absl::Now();
   std::vector<bool> include(problem.buffers.size(), true);
   std::vector<BufferIdx> subset;
@@ -538,7 +1428,7 @@ absl::StatusOr<std::vector<BufferIdx>>
     for (BufferIdx idx = 0; idx < problem.buffers.size(); ++idx) {
       if (include[idx]) subproblem.buffers.push_back(problem.buffers[idx]);
     }
-    auto solution = SolveWithStartTime(subproblem, start_time);
+    auto solution = SolveWithStartTime(subproblem, start_time, context);
     if (absl::IsDeadlineExceeded(solution.status())) return solution.status();
     if ((include[buffer_idx] = solution.ok())) subset.push_back(buffer_idx);
   }
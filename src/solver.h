@@ -28,6 +28,8 @@ limitations under the License.
 
 namespace minimalloc {
 
+class SolutionCache;
+
 using CanonicalOnlyParam = bool;
 using SectionInferenceParam = bool;
 using DynamicOrderingParam = bool;
@@ -37,6 +39,11 @@ using StaticPreorderingParam = bool;
 using DynamicDecompositionParam = bool;
 using MonotonicFloorParam = bool;
 using HatlessPruningParam = bool;
+using DeduplicatePartitionsParam = bool;
+using BreakSymmetriesParam = bool;
+using NormalizeScaleParam = bool;
+using SmallPartitionSearchParam = bool;
+using DenseOverlapsParam = bool;
 using PreorderingHeuristic = std::string;
 
 // Various settings that enable / disable certain advanced search & inference
@@ -77,6 +84,25 @@ struct SolverParams {
   // Prunes alternate solutions whenever a buffer has nothing overhead.
   HatlessPruningParam hatless_pruning = true;
 
+  // Solves each distinct partition shape once (ie, up to a shift in time), and
+  // replays its offsets for any duplicates.
+  DeduplicatePartitionsParam deduplicate_partitions = true;
+
+  // Places interchangeable buffers (see presolve.h) in order of their index.
+  BreakSymmetriesParam break_symmetries = true;
+
+  // Divides all sizes & offsets by their common divisor (see presolve.h).
+  NormalizeScaleParam normalize_scale = true;
+
+  // Solves partitions of only a few buffers with a dedicated search, whose
+  // state lives in fixed-size arrays & bitmasks rather than on the heap.
+  SmallPartitionSearchParam small_partition_search = true;
+
+  // Keeps the overlaps of large, dense partitions as bitsets, so that finding
+  // a buffer's unallocated neighbors is a sweep of bitwise ANDs.  Off by
+  // default, since it has yet to pay off on the benchmarks.
+  DenseOverlapsParam dense_overlaps = false;
+
   // The static preordering heuristics to attempt.
   std::vector<PreorderingHeuristic> preordering_heuristics =
       {"WAT", "TAW", "TWA"};
@@ -89,7 +115,7 @@ struct PreorderData {
   uint64_t overlaps;  // The number of pairwise overlaps with other buffers.
   int sections;  // The number of sections spanned by this buffer.
   int64_t size;  // The size of the buffer.
-  int total;  // The (maximum) total sum in any of this buffer's sections.
+  int64_t total;  // The (maximum) total sum in any of this buffer's sections.
   TimeValue upper;  // When does the buffer end?
   int64_t width;  // The width of this buffer's lifespan.
   BufferIdx buffer_idx;  // An index into a Problem's list of buffers.
@@ -104,30 +130,81 @@ class PreorderingComparator {
   PreorderingHeuristic preordering_heuristic_;
 };
 
+// Counters and timings gathered over the solver's latest invocation.
+struct SolverStats {
+  int64_t backtracks = 0;  // The number of times the search backtracked.
+  int64_t nodes = 0;  // The number of partial solutions explored.
+  int64_t reused_partitions = 0;  // Partitions solved by earlier duplicates.
+  absl::Duration sweep_time;  // Time spent sweeping the problem.
+  absl::Duration setup_time;  // Time spent on section totals & preorderings.
+  absl::Duration search_time;  // Time spent in the search itself.
+};
+
+// The state of a single invocation of the solver: its statistics, and a token
+// that may be used (from any thread) to cancel it.  Concurrent invocations of a
+// shared Solver must each be given their own context.
+class SolveContext {
+ public:
+  // Returns the statistics gathered so far.
+  const SolverStats& get_stats() const { return stats_; }
+  SolverStats* mutable_stats() { return &stats_; }
+
+  // Cancels search.
+  void Cancel() { cancelled_ = true; }
+  bool is_cancelled() const { return cancelled_; }
+
+  // Clears the statistics and cancellation token, for reuse.
+  void Reset();
+
+ private:
+  SolverStats stats_;
+  std::atomic<bool> cancelled_ = false;
+};
+
 class Solver {
  public:
   Solver();
   virtual ~Solver() = default;
   explicit Solver(const SolverParams& params);
+
+  // As above, but also looks up each distinct partition shape (of sufficient
+  // size) in the given cache, which must outlive the solver.
+  Solver(const SolverParams& params, const SolutionCache* partition_cache);
+
+  // Solves the problem using the solver's own context, which is reset first.
+  // Not safe to call concurrently; use the reentrant overload for that.
   absl::StatusOr<Solution> Solve(const Problem& problem);
 
+  // A reentrant variant that records its state in the given context, which may
+  // be cancelled even before the call begins.
+  absl::StatusOr<Solution> Solve(const Problem& problem,
+                                 SolveContext& context) const;
+
+  const SolverParams& get_params() const { return params_; }
+
   // Returns the number of backtracks in the solver's latest invocation.
   int64_t get_backtracks() const;
 
+  // Returns the statistics of the solver's latest invocation.
+  const SolverStats& get_stats() const;
+
   // Cancels search.
   void Cancel();
 
   // A naïve approach to compute an irreducible infeasible subset of buffers.
   absl::StatusOr<std::vector<BufferIdx>> ComputeIrreducibleInfeasibleSubset(
       const Problem& problem);
+  absl::StatusOr<std::vector<BufferIdx>> ComputeIrreducibleInfeasibleSubset(
+      const Problem& problem, SolveContext& context) const;
 
  protected:
-  virtual absl::StatusOr<Solution> SolveWithStartTime(const Problem& problem,
-                                                      absl::Time start_time);
+  virtual absl::StatusOr<Solution> SolveWithStartTime(
+      const Problem& problem, absl::Time start_time,
+      SolveContext& context) const;
 
   const SolverParams params_;
-  int64_t backtracks_ = 0;  // A counter that maintains backtrack count.
-  std::atomic<bool> cancelled_ = false;
+  const SolutionCache* const partition_cache_ = nullptr;
+  SolveContext context_;  // Used by the non-reentrant methods.
 };
 
 }  // namespace minimalloc
@@ -17,10 +17,13 @@ limitations under the License.
 #include "sweeper.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <deque>
 #include <optional>
+#include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/container/btree_set.h"
 #include "absl/container/flat_hash_set.h"
 #include "minimalloc.h"
@@ -205,17 +208,233 @@ SweepResult Sweep(const Problem& problem) {
 // Calculates the number of "cuts," i.e., buffers that are active between
 // adjacent sections.  If there are zero cuts between sections i and i+1, it
 // implies that the sections {..., i-2, i-1, i} and {i+1, i+2, ...} may be
-// solved separately.
+// solved separately.  Each buffer marks the endpoints of its range in a
+// difference array, so long-lived buffers cost no more than short ones.
 std::vector<CutCount> SweepResult::CalculateCuts() const {
-  std::vector<CutCount> cuts(sections.size() - 1);
+  if (sections.empty()) return {};
+  std::vector<CutCount> cuts(sections.size());
   for (const BufferData& buffer_data : buffer_data) {
     const std::vector<SectionSpan>& section_spans = buffer_data.section_spans;
-    for (SectionIdx s_idx = section_spans.front().section_range.lower();
-        s_idx + 1 < section_spans.back().section_range.upper(); ++s_idx) {
-      ++cuts[s_idx];
-    }
+    if (section_spans.empty()) continue;
+    const SectionIdx lower = section_spans.front().section_range.lower();
+    const SectionIdx upper = section_spans.back().section_range.upper();
+    if (lower + 1 >= upper) continue;
+    ++cuts[lower];
+    --cuts[upper - 1];
+  }
+  for (SectionIdx s_idx = 1; s_idx < cuts.size(); ++s_idx) {
+    cuts[s_idx] += cuts[s_idx - 1];
   }
+  cuts.pop_back();
   return cuts;
 }
 
+// Calculates the total size of each section using a difference array over the
+// section spans of every buffer.
+std::vector<int64_t> SweepResult::CalculateTotals() const {
+  std::vector<int64_t> totals(sections.size() + 1);
+  for (const BufferData& buffer_data : buffer_data) {
+    for (const SectionSpan& section_span : buffer_data.section_spans) {
+      const SectionRange& section_range = section_span.section_range;
+      const Window& window = section_span.window;
+      totals[section_range.lower()] += window.upper() - window.lower();
+      totals[section_range.upper()] -= window.upper() - window.lower();
+    }
+  }
+  for (SectionIdx s_idx = 1; s_idx < totals.size(); ++s_idx) {
+    totals[s_idx] += totals[s_idx - 1];
+  }
+  totals.pop_back();
+  return totals;
+}
+
+IncrementalSweeper::IncrementalSweeper(Problem problem)
+    : problem_(std::move(problem)) {
+  sweep_result_.buffer_data.resize(problem_.buffers.size());
+  std::vector<BufferIdx> buffer_idxs(problem_.buffers.size());
+  for (BufferIdx buffer_idx = 0; buffer_idx < buffer_idxs.size(); ++buffer_idx) {
+    buffer_idxs[buffer_idx] = buffer_idx;
+  }
+  Resweep({0, 0}, std::move(buffer_idxs));
+}
+
+BufferIdx IncrementalSweeper::AddBuffer(Buffer buffer) {
+  const BufferIdx buffer_idx = problem_.buffers.size();
+  const auto partition_range = FindPartitions(buffer.lifespan);
+  problem_.buffers.push_back(std::move(buffer));
+  sweep_result_.buffer_data.emplace_back();
+  std::vector<BufferIdx> buffer_idxs = CollectBuffers(partition_range);
+  buffer_idxs.push_back(buffer_idx);
+  Resweep(partition_range, std::move(buffer_idxs));
+  return buffer_idx;
+}
+
+void IncrementalSweeper::RemoveBuffer(BufferIdx buffer_idx) {
+  const auto partition_range =
+      FindPartitions(problem_.buffers[buffer_idx].lifespan);
+  Resweep(partition_range, CollectBuffers(partition_range, buffer_idx));
+  // Move the last buffer into the vacated slot, then sweep its partition again
+  // so that every reference to its old index is replaced.
+  const BufferIdx last_idx = problem_.buffers.size() - 1;
+  if (buffer_idx != last_idx) {
+    problem_.buffers[buffer_idx] = std::move(problem_.buffers[last_idx]);
+  }
+  problem_.buffers.pop_back();
+  sweep_result_.buffer_data.pop_back();
+  if (buffer_idx == last_idx) return;
+  const auto last_range = FindPartitions(problem_.buffers[buffer_idx].lifespan);
+  std::vector<BufferIdx> buffer_idxs = CollectBuffers(last_range, last_idx);
+  buffer_idxs.push_back(buffer_idx);
+  Resweep(last_range, std::move(buffer_idxs));
+}
+
+void IncrementalSweeper::UpdateLifespan(BufferIdx buffer_idx,
+                                        Lifespan lifespan) {
+  Lifespan& old_lifespan = problem_.buffers[buffer_idx].lifespan;
+  const auto old_range = FindPartitions(old_lifespan);
+  const auto new_range = FindPartitions(lifespan);
+  // Any partitions between the old & new ranges are swept again as well.
+  const std::pair<int, int> partition_range = {
+      std::min(old_range.first, new_range.first),
+      std::max(old_range.second, new_range.second)};
+  old_lifespan = lifespan;
+  std::vector<BufferIdx> buffer_idxs =
+      CollectBuffers(partition_range, buffer_idx);
+  buffer_idxs.push_back(buffer_idx);
+  Resweep(partition_range, std::move(buffer_idxs));
+}
+
+std::pair<int, int> IncrementalSweeper::FindPartitions(
+    const Lifespan& lifespan) const {
+  // Partitions are sorted by time & disjoint, so a binary search suffices.
+  const auto begin = partition_lifespans_.begin();
+  const auto end = partition_lifespans_.end();
+  const auto lower = std::partition_point(begin, end,
+      [&](const Lifespan& p) { return p.upper() <= lifespan.lower(); });
+  const auto upper = std::partition_point(lower, end,
+      [&](const Lifespan& p) { return p.lower() < lifespan.upper(); });
+  return {lower - begin, upper - begin};
+}
+
+std::vector<BufferIdx> IncrementalSweeper::CollectBuffers(
+    std::pair<int, int> partition_range, BufferIdx skip_idx) const {
+  std::vector<BufferIdx> buffer_idxs;
+  for (int p_idx = partition_range.first; p_idx < partition_range.second;
+       ++p_idx) {
+    for (const BufferIdx buffer_idx :
+         sweep_result_.partitions[p_idx].buffer_idxs) {
+      if (buffer_idx != skip_idx) buffer_idxs.push_back(buffer_idx);
+    }
+  }
+  return buffer_idxs;
+}
+
+void IncrementalSweeper::Resweep(std::pair<int, int> partition_range,
+                                 std::vector<BufferIdx> buffer_idxs) {
+  const auto [p_begin, p_end] = partition_range;
+  std::vector<Section>& sections = sweep_result_.sections;
+  std::vector<Partition>& partitions = sweep_result_.partitions;
+  const SectionIdx num_sections = sections.size();
+  const SectionIdx s_begin = p_begin < partitions.size()
+      ? partitions[p_begin].section_range.lower() : num_sections;
+  const SectionIdx s_end = p_begin < p_end
+      ? partitions[p_end - 1].section_range.upper() : s_begin;
+  // Sweep the affected buffers on their own.  Since the subproblem indices are
+  // assigned in ascending order, the relative order of all points is preserved.
+  absl::c_sort(buffer_idxs);
+  Problem subproblem;
+  subproblem.buffers.reserve(buffer_idxs.size());
+  for (const BufferIdx buffer_idx : buffer_idxs) {
+    subproblem.buffers.push_back(problem_.buffers[buffer_idx]);
+  }
+  SweepResult sub_result = Sweep(subproblem);
+  const SectionIdx num_sub_sections = sub_result.sections.size();
+  const SectionIdx delta = num_sub_sections - (s_end - s_begin);
+  // Splice the cuts.  Those on the boundary of the region are always zero, and
+  // the remainder are internal to the newly swept partitions.
+  std::vector<CutCount> sub_cuts;
+  if (num_sub_sections > 0) sub_cuts = sub_result.CalculateCuts();
+  std::vector<CutCount> region_cuts;
+  for (SectionIdx c_idx = std::max(s_begin - 1, 0);
+       c_idx + 1 < num_sections + delta && c_idx < s_begin + num_sub_sections;
+       ++c_idx) {
+    const bool boundary =
+        c_idx == s_begin - 1 || c_idx == s_begin + num_sub_sections - 1;
+    region_cuts.push_back(boundary ? 0 : sub_cuts[c_idx - s_begin]);
+  }
+  const SectionIdx c_begin = std::max(s_begin - 1, 0);
+  const SectionIdx c_end = std::max(c_begin, std::min(s_end, num_sections - 1));
+  cuts_.erase(cuts_.begin() + c_begin, cuts_.begin() + c_end);
+  cuts_.insert(cuts_.begin() + c_begin, region_cuts.begin(), region_cuts.end());
+  // Splice the sections.
+  for (Section& section : sub_result.sections) {
+    Section mapped_section;
+    mapped_section.reserve(section.size());
+    for (const BufferIdx idx : section) {
+      mapped_section.insert(buffer_idxs[idx]);
+    }
+    section = std::move(mapped_section);
+  }
+  sections.erase(sections.begin() + s_begin, sections.begin() + s_end);
+  sections.insert(sections.begin() + s_begin,
+                  std::make_move_iterator(sub_result.sections.begin()),
+                  std::make_move_iterator(sub_result.sections.end()));
+  // Shift the section indices of any subsequent partitions (and their buffers).
+  if (delta != 0) {
+    for (int p_idx = p_end; p_idx < partitions.size(); ++p_idx) {
+      Partition& partition = partitions[p_idx];
+      partition.section_range = {partition.section_range.lower() + delta,
+                                 partition.section_range.upper() + delta};
+      for (const BufferIdx buffer_idx : partition.buffer_idxs) {
+        BufferData& buffer_data = sweep_result_.buffer_data[buffer_idx];
+        for (SectionSpan& section_span : buffer_data.section_spans) {
+          const SectionRange& section_range = section_span.section_range;
+          section_span.section_range = {section_range.lower() + delta,
+                                        section_range.upper() + delta};
+        }
+      }
+    }
+  }
+  // Splice the partitions, recording the overall lifespan of each.
+  std::vector<Lifespan> sub_lifespans;
+  sub_lifespans.reserve(sub_result.partitions.size());
+  for (Partition& partition : sub_result.partitions) {
+    Lifespan lifespan = subproblem.buffers[partition.buffer_idxs[0]].lifespan;
+    for (BufferIdx& buffer_idx : partition.buffer_idxs) {
+      const Lifespan& other = subproblem.buffers[buffer_idx].lifespan;
+      lifespan = {std::min(lifespan.lower(), other.lower()),
+                  std::max(lifespan.upper(), other.upper())};
+      buffer_idx = buffer_idxs[buffer_idx];
+    }
+    partition.section_range = {partition.section_range.lower() + s_begin,
+                               partition.section_range.upper() + s_begin};
+    sub_lifespans.push_back(lifespan);
+  }
+  partitions.erase(partitions.begin() + p_begin, partitions.begin() + p_end);
+  partitions.insert(partitions.begin() + p_begin,
+                    std::make_move_iterator(sub_result.partitions.begin()),
+                    std::make_move_iterator(sub_result.partitions.end()));
+  partition_lifespans_.erase(partition_lifespans_.begin() + p_begin,
+                             partition_lifespans_.begin() + p_end);
+  partition_lifespans_.insert(partition_lifespans_.begin() + p_begin,
+                              sub_lifespans.begin(), sub_lifespans.end());
+  // Finally, overwrite the data of each affected buffer.
+  for (BufferIdx idx = 0; idx < buffer_idxs.size(); ++idx) {
+    BufferData& sub_data = sub_result.buffer_data[idx];
+    BufferData& buffer_data = sweep_result_.buffer_data[buffer_idxs[idx]];
+    for (SectionSpan& section_span : sub_data.section_spans) {
+      const SectionRange& section_range = section_span.section_range;
+      section_span.section_range = {section_range.lower() + s_begin,
+                                    section_range.upper() + s_begin};
+    }
+    buffer_data.section_spans = std::move(sub_data.section_spans);
+    buffer_data.overlaps.clear();
+    for (const Overlap& overlap : sub_data.overlaps) {
+      buffer_data.overlaps.insert(
+          buffer_data.overlaps.end(),
+          {buffer_idxs[overlap.buffer_idx], overlap.effective_size});
+    }
+  }
+}
+
 }  // namespace minimalloc
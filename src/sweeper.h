@@ -17,6 +17,8 @@ limitations under the License.
 #ifndef MINIMALLOC_SRC_SWEEPER_H_
 #define MINIMALLOC_SRC_SWEEPER_H_
 
+#include <cstdint>
+#include <utility>
 #include <vector>
 
 #include "minimalloc.h"
@@ -156,6 +158,10 @@ struct SweepResult {
   // number of buffers that are active in both section i and section i + 1.
   std::vector<CutCount> CalculateCuts() const;
 
+  // Returns a vector of length sections.size() where the ith element is the
+  // total size of all buffer windows that are active in section i.
+  std::vector<int64_t> CalculateTotals() const;
+
   bool operator==(const SweepResult& x) const;
 };
 
@@ -180,6 +186,50 @@ std::vector<SweepPoint> CreatePoints(const Problem& problem);
 // cross sections.
 SweepResult Sweep(const Problem& problem);
 
+// Maintains a problem's SweepResult (along with its cuts) under local edits.
+// Since partitions never overlap in time, an edit can only affect the
+// partitions whose lifespans intersect that of the modified buffer.  Those
+// partitions are swept again in isolation and spliced back into the result,
+// which remains identical to what Sweep would produce from scratch.
+class IncrementalSweeper {
+ public:
+  explicit IncrementalSweeper(Problem problem);
+
+  const Problem& problem() const { return problem_; }
+  const SweepResult& sweep_result() const { return sweep_result_; }
+  const std::vector<CutCount>& cuts() const { return cuts_; }
+
+  // Appends a buffer to the problem, and returns its index.
+  BufferIdx AddBuffer(Buffer buffer);
+
+  // Removes a buffer from the problem.  As with a swap-and-pop, the last buffer
+  // is moved into the vacated slot; all other buffer indices are unaffected.
+  void RemoveBuffer(BufferIdx buffer_idx);
+
+  // Changes the lifespan of a buffer (any gaps must still fall within it).
+  void UpdateLifespan(BufferIdx buffer_idx, Lifespan lifespan);
+
+ private:
+  // Returns the half-open range of partitions that intersect the lifespan.
+  std::pair<int, int> FindPartitions(const Lifespan& lifespan) const;
+
+  // Collects the buffers in a range of partitions (skipping the given index).
+  std::vector<BufferIdx> CollectBuffers(std::pair<int, int> partition_range,
+                                        BufferIdx skip_idx = -1) const;
+
+  // Replaces a range of partitions with the result of sweeping the given
+  // buffers, and shifts the section indices of any subsequent partitions.
+  void Resweep(std::pair<int, int> partition_range,
+               std::vector<BufferIdx> buffer_idxs);
+
+  Problem problem_;
+  SweepResult sweep_result_;
+  std::vector<CutCount> cuts_;
+
+  // The overall lifespan of each partition (in the same order as partitions).
+  std::vector<Lifespan> partition_lifespans_;
+};
+
 }  // namespace minimalloc
 
 #endif  // MINIMALLOC_SRC_SWEEPER_H_
@@ -16,12 +16,157 @@ limitations under the License.
 
 #include "validator.h"
 
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <iterator>
 #include <optional>
+#include <tuple>
+#include <utility>
 #include <vector>
 
+#include "absl/container/btree_map.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/blocking_counter.h"
 #include "minimalloc.h"
+#include "thread_pool.h"
 
 namespace minimalloc {
+namespace {
+
+// A maximal period of time during which a buffer occupies a fixed (absolute)
+// range of memory.
+struct Piece {
+  BufferIdx buffer_idx;
+  Lifespan lifespan;
+  Window window;
+};
+
+// The number of time shards handed to each thread by ValidateAll.
+constexpr int kShardsPerThread = 4;
+
+// Breaks a buffer into the pieces it actually occupies, skipping any gaps (or
+// portions of gaps) that don't consume memory.
+void AppendPieces(const Buffer& buffer, BufferIdx buffer_idx, Offset offset,
+                  std::vector<Piece>& pieces) {
+  auto append = [&pieces, buffer_idx, offset](TimeValue lower, TimeValue upper,
+                                              Window window) {
+    if (lower >= upper || window.lower() >= window.upper()) return;
+    pieces.push_back({buffer_idx, {lower, upper},
+                      {offset + window.lower(), offset + window.upper()}});
+  };
+  std::vector<const Gap*> gaps;
+  gaps.reserve(buffer.gaps.size());
+  for (const Gap& gap : buffer.gaps) gaps.push_back(&gap);
+  std::sort(gaps.begin(), gaps.end(), [](const Gap* a, const Gap* b) {
+    return a->lifespan.lower() < b->lifespan.lower();
+  });
+  const Window window = {0, buffer.size};
+  TimeValue time = buffer.lifespan.lower();
+  for (const Gap* gap : gaps) {
+    const TimeValue lower = std::max(gap->lifespan.lower(), time);
+    const TimeValue upper =
+        std::min(gap->lifespan.upper(), buffer.lifespan.upper());
+    if (lower >= upper) continue;
+    append(time, lower, window);
+    if (gap->window) append(lower, upper, *gap->window);
+    time = upper;
+  }
+  append(time, buffer.lifespan.upper(), window);
+}
+
+std::vector<Piece> CreatePieces(const Problem& problem,
+                                const Solution& solution) {
+  std::vector<Piece> pieces;
+  pieces.reserve(problem.buffers.size());
+  for (BufferIdx buffer_idx = 0; buffer_idx < problem.buffers.size();
+       ++buffer_idx) {
+    AppendPieces(problem.buffers[buffer_idx], buffer_idx,
+                 solution.offsets[buffer_idx], pieces);
+  }
+  return pieces;
+}
+
+// Reports every overlap whose period of collision begins within the given
+// shard of time.  Active pieces may overlap one another here, so any that do
+// are tracked separately: a piece can only overlap a new one without also
+// overlapping that new piece's nearest non-overlapping predecessor (in space)
+// if it overlaps the predecessor too.
+std::vector<Violation> FindOverlaps(const std::vector<Piece>& pieces,
+                                    Lifespan shard) {
+  std::vector<std::pair<std::pair<TimeValue, bool>, int64_t>> events;
+  for (int64_t piece_idx = 0; piece_idx < pieces.size(); ++piece_idx) {
+    const Lifespan& lifespan = pieces[piece_idx].lifespan;
+    if (lifespan.upper() <= shard.lower()) continue;
+    if (lifespan.lower() >= shard.upper()) continue;
+    const TimeValue lower = std::max(lifespan.lower(), shard.lower());
+    events.push_back({{lower, true}, piece_idx});
+    if (lifespan.upper() < shard.upper()) {
+      events.push_back({{lifespan.upper(), false}, piece_idx});
+    }
+  }
+  std::sort(events.begin(), events.end());
+  std::vector<Violation> violations;
+  absl::btree_multimap<Offset, int64_t> active;  // Maps lowers to pieces.
+  absl::flat_hash_set<int64_t> overlapping;  // Active pieces w/ an overlap.
+  auto overlap = [&](int64_t piece_idx, int64_t other_idx) {
+    overlapping.insert(piece_idx);
+    overlapping.insert(other_idx);
+    const Piece& piece = pieces[piece_idx];
+    const Piece& other = pieces[other_idx];
+    const TimeValue lower =
+        std::max(piece.lifespan.lower(), other.lifespan.lower());
+    if (lower < shard.lower()) return;  // Reported by an earlier shard.
+    const TimeValue upper =
+        std::min(piece.lifespan.upper(), other.lifespan.upper());
+    violations.push_back({
+        .kind = kBadOverlap,
+        .buffer_idx = std::min(piece.buffer_idx, other.buffer_idx),
+        .other_idx = std::max(piece.buffer_idx, other.buffer_idx),
+        .lifespan = Lifespan{lower, upper}});
+  };
+  for (const auto& [key, piece_idx] : events) {
+    const Window& window = pieces[piece_idx].window;
+    if (!key.second) {
+      auto it = active.find(window.lower());
+      while (it->second != piece_idx) ++it;
+      active.erase(it);
+      overlapping.erase(piece_idx);
+      continue;
+    }
+    // Pieces starting within this one all overlap it.
+    auto next = active.lower_bound(window.lower());
+    absl::flat_hash_set<int64_t> others;
+    for (auto it = next;
+         it != active.end() && it->first < window.upper(); ++it) {
+      others.insert(it->second);
+    }
+    // Pieces starting below this one overlap it up until the first that
+    // doesn't, after which only those already known to overlap may.
+    for (auto it = next; it != active.begin(); ) {
+      --it;
+      if (pieces[it->second].window.upper() <= window.lower()) break;
+      others.insert(it->second);
+    }
+    for (const int64_t other_idx : overlapping) {
+      const Window& other = pieces[other_idx].window;
+      if (other.lower() < window.upper() && other.upper() > window.lower()) {
+        others.insert(other_idx);
+      }
+    }
+    for (const int64_t other_idx : others) overlap(piece_idx, other_idx);
+    active.insert(next, {window.lower(), piece_idx});
+  }
+  return violations;
+}
+
+}  // namespace
+
+bool Violation::operator==(const Violation& x) const {
+  return kind == x.kind && buffer_idx == x.buffer_idx &&
+         other_idx == x.other_idx && lifespan == x.lifespan;
+}
 
 ValidationResult Validate(const Problem& problem, const Solution& solution) {
   // Check that the number of buffers matches the number of offsets.
@@ -35,19 +180,253 @@ ValidationResult Validate(const Problem& problem, const Solution& solution) {
     if (offset + buffer.size > problem.capacity) return kBadOffset;
     if (offset % buffer.alignment != 0) return kBadAlignment;
   }
-  // Check that no two buffers overlap in both space and time, the O(n^2) way.
-  for (BufferIdx i = 0; i < problem.buffers.size(); ++i) {
-    const Buffer& buffer_i = problem.buffers[i];
-    const Offset offset_i = solution.offsets[i];
-    for (BufferIdx j = i + 1; j < problem.buffers.size(); ++j) {
-      const Buffer& buffer_j = problem.buffers[j];
-      const Offset offset_j = solution.offsets[j];
-      const auto buffer_i_size = buffer_i.effective_size(buffer_j);
-      const auto buffer_j_size = buffer_j.effective_size(buffer_i);
-      if (!buffer_i_size || offset_i + *buffer_i_size <= offset_j) continue;
-      if (!buffer_j_size || offset_j + *buffer_j_size <= offset_i) continue;
+  // Check that no two buffers overlap in both space and time by sweeping over
+  // the pieces in temporal order.  Since the active pieces never overlap, each
+  // new piece only needs to be checked against its neighbors in space.
+  const std::vector<Piece> pieces = CreatePieces(problem, solution);
+  // Each event is a (time, is_start, piece_idx) triple, where pieces that end
+  // at a given time are removed before the ones that start there are added.
+  std::vector<std::pair<std::pair<TimeValue, bool>, int64_t>> events;
+  events.reserve(pieces.size() * 2);
+  for (int64_t piece_idx = 0; piece_idx < pieces.size(); ++piece_idx) {
+    const Lifespan& lifespan = pieces[piece_idx].lifespan;
+    events.push_back({{lifespan.lower(), true}, piece_idx});
+    events.push_back({{lifespan.upper(), false}, piece_idx});
+  }
+  std::sort(events.begin(), events.end());
+  absl::btree_map<Offset, Offset> active;  // Maps each lower to its upper.
+  for (const auto& [key, piece_idx] : events) {
+    const Window& window = pieces[piece_idx].window;
+    if (!key.second) {
+      active.erase(window.lower());
+      continue;
+    }
+    auto next = active.lower_bound(window.lower());
+    if (next != active.end() && next->first < window.upper()) {
       return kBadOverlap;
     }
+    if (next != active.begin() && std::prev(next)->second > window.lower()) {
+      return kBadOverlap;
+    }
+    active.emplace_hint(next, window.lower(), window.upper());
+  }
+  return kGood;
+}
+
+ValidationReport ValidateAll(const Problem& problem, const Solution& solution,
+                             int num_threads) {
+  ValidationReport report;
+  if (problem.buffers.size() != solution.offsets.size()) {
+    report.result = kBadSolution;
+    return report;
+  }
+  std::vector<Violation>& violations = report.violations;
+  for (auto buffer_idx = 0; buffer_idx < problem.buffers.size(); ++buffer_idx) {
+    const Buffer& buffer = problem.buffers[buffer_idx];
+    const Offset offset = solution.offsets[buffer_idx];
+    auto add = [&violations, buffer_idx](ValidationResult kind) {
+      violations.push_back({.kind = kind, .buffer_idx = buffer_idx});
+    };
+    if (buffer.offset && *buffer.offset != offset) add(kBadFixed);
+    if (offset < 0 || offset + buffer.size > problem.capacity) add(kBadOffset);
+    if (offset % buffer.alignment != 0) add(kBadAlignment);
+  }
+  // Split time into shards holding roughly the same number of starting pieces.
+  const std::vector<Piece> pieces = CreatePieces(problem, solution);
+  std::vector<TimeValue> lowers;
+  lowers.reserve(pieces.size());
+  for (const Piece& piece : pieces) lowers.push_back(piece.lifespan.lower());
+  std::sort(lowers.begin(), lowers.end());
+  const int num_shards = std::max<int64_t>(
+      std::min<int64_t>(num_threads * kShardsPerThread, lowers.size()), 1);
+  std::vector<TimeValue> boundaries = {INT64_MIN};
+  for (int shard_idx = 1; shard_idx < num_shards; ++shard_idx) {
+    const TimeValue boundary = lowers[lowers.size() * shard_idx / num_shards];
+    if (boundary > boundaries.back()) boundaries.push_back(boundary);
+  }
+  boundaries.push_back(INT64_MAX);
+  std::vector<std::vector<Violation>> overlaps(boundaries.size() - 1);
+  if (overlaps.size() == 1 || num_threads <= 1) {
+    for (int shard_idx = 0; shard_idx < overlaps.size(); ++shard_idx) {
+      overlaps[shard_idx] = FindOverlaps(
+          pieces, {boundaries[shard_idx], boundaries[shard_idx + 1]});
+    }
+  } else {
+    ThreadPool thread_pool(num_threads);
+    absl::BlockingCounter counter(overlaps.size());
+    for (int shard_idx = 0; shard_idx < overlaps.size(); ++shard_idx) {
+      thread_pool.Schedule([&, shard_idx]() {
+        overlaps[shard_idx] = FindOverlaps(
+            pieces, {boundaries[shard_idx], boundaries[shard_idx + 1]});
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+  for (const std::vector<Violation>& shard_overlaps : overlaps) {
+    violations.insert(violations.end(), shard_overlaps.begin(),
+                      shard_overlaps.end());
+  }
+  // Sort the violations, merging any overlaps that pick up where another
+  // (between the same pair of buffers) leaves off.
+  auto key = [](const Violation& v) {
+    return std::tie(v.buffer_idx, v.other_idx, v.kind, v.lifespan);
+  };
+  std::sort(violations.begin(), violations.end(),
+            [&key](const Violation& a, const Violation& b) {
+              return key(a) < key(b);
+            });
+  int64_t num_merged = 0;
+  for (const Violation& violation : violations) {
+    if (num_merged > 0) {
+      Violation& last = violations[num_merged - 1];
+      if (violation.kind == kBadOverlap && last.kind == kBadOverlap &&
+          violation.buffer_idx == last.buffer_idx &&
+          violation.other_idx == last.other_idx &&
+          violation.lifespan->lower() <= last.lifespan->upper()) {
+        last.lifespan = Lifespan{
+            last.lifespan->lower(),
+            std::max(last.lifespan->upper(), violation.lifespan->upper())};
+        continue;
+      }
+    }
+    violations[num_merged++] = violation;
+  }
+  violations.resize(num_merged);
+  // Report the same result that Validate would.
+  for (const Violation& violation : violations) {
+    if (violation.kind != kBadOverlap) {
+      report.result = violation.kind;
+      break;
+    }
+    report.result = kBadOverlap;
+  }
+  return report;
+}
+
+IncrementalValidator::IncrementalValidator(Problem problem, Solution solution)
+    : problem_(std::move(problem)), solution_(std::move(solution)) {
+  const std::vector<Buffer>& buffers = problem_.buffers;
+  const Solution origin = {.offsets = std::vector<Offset>(buffers.size())};
+  const std::vector<Piece> pieces = CreatePieces(problem_, origin);
+  piece_starts_.assign(buffers.size() + 1, 0);
+  piece_lifespans_.reserve(pieces.size());
+  piece_windows_.reserve(pieces.size());
+  for (const Piece& piece : pieces) {
+    ++piece_starts_[piece.buffer_idx + 1];
+    piece_lifespans_.push_back(piece.lifespan);
+    piece_windows_.push_back(piece.window);
+  }
+  for (BufferIdx buffer_idx = 0; buffer_idx < buffers.size(); ++buffer_idx) {
+    piece_starts_[buffer_idx + 1] += piece_starts_[buffer_idx];
+  }
+  // Sweep over the buffers in order of their start times to find neighbors.
+  std::vector<BufferIdx> order(buffers.size());
+  for (BufferIdx buffer_idx = 0; buffer_idx < buffers.size(); ++buffer_idx) {
+    order[buffer_idx] = buffer_idx;
+  }
+  std::sort(order.begin(), order.end(), [&buffers](BufferIdx a, BufferIdx b) {
+    return buffers[a].lifespan.lower() < buffers[b].lifespan.lower();
+  });
+  std::vector<std::vector<BufferIdx>> neighbors(buffers.size());
+  std::vector<BufferIdx> active;
+  for (const BufferIdx buffer_idx : order) {
+    const Lifespan& lifespan = buffers[buffer_idx].lifespan;
+    if (lifespan.lower() >= lifespan.upper()) continue;
+    int64_t num_active = 0;
+    for (const BufferIdx other_idx : active) {
+      if (buffers[other_idx].lifespan.upper() <= lifespan.lower()) continue;
+      active[num_active++] = other_idx;
+      neighbors[buffer_idx].push_back(other_idx);
+      neighbors[other_idx].push_back(buffer_idx);
+    }
+    active.resize(num_active);
+    active.push_back(buffer_idx);
+  }
+  neighbor_starts_.reserve(buffers.size() + 1);
+  neighbor_starts_.push_back(0);
+  for (const std::vector<BufferIdx>& buffer_neighbors : neighbors) {
+    neighbors_.insert(neighbors_.end(), buffer_neighbors.begin(),
+                      buffer_neighbors.end());
+    neighbor_starts_.push_back(neighbors_.size());
+  }
+}
+
+bool IncrementalValidator::Overlaps(BufferIdx buffer_idx, Offset offset,
+                                    BufferIdx other_idx,
+                                    Offset other_offset) const {
+  // Both lists of pieces are in temporal order, so walk them side-by-side.
+  int64_t piece_idx = piece_starts_[buffer_idx];
+  int64_t other_piece_idx = piece_starts_[other_idx];
+  while (piece_idx < piece_starts_[buffer_idx + 1] &&
+         other_piece_idx < piece_starts_[other_idx + 1]) {
+    const Lifespan& lifespan = piece_lifespans_[piece_idx];
+    const Lifespan& other_lifespan = piece_lifespans_[other_piece_idx];
+    if (lifespan.lower() < other_lifespan.upper() &&
+        other_lifespan.lower() < lifespan.upper()) {
+      const Window& window = piece_windows_[piece_idx];
+      const Window& other_window = piece_windows_[other_piece_idx];
+      if (offset + window.lower() < other_offset + other_window.upper() &&
+          other_offset + other_window.lower() < offset + window.upper()) {
+        return true;
+      }
+    }
+    if (lifespan.upper() < other_lifespan.upper()) {
+      ++piece_idx;
+    } else {
+      ++other_piece_idx;
+    }
+  }
+  return false;
+}
+
+ValidationResult IncrementalValidator::Check(
+    const std::vector<OffsetChange>& changes) const {
+  absl::flat_hash_map<BufferIdx, Offset> offsets;
+  for (const OffsetChange& change : changes) {
+    if (change.buffer_idx < 0 || change.buffer_idx >= problem_.buffers.size()) {
+      return kBadSolution;
+    }
+    offsets[change.buffer_idx] = change.offset;
+  }
+  std::vector<BufferIdx> buffer_idxs;
+  buffer_idxs.reserve(offsets.size());
+  for (const auto& [buffer_idx, offset] : offsets) {
+    buffer_idxs.push_back(buffer_idx);
+  }
+  std::sort(buffer_idxs.begin(), buffer_idxs.end());
+  // Check fixed buffers & check that offsets are within the allowable range.
+  for (const BufferIdx buffer_idx : buffer_idxs) {
+    const Buffer& buffer = problem_.buffers[buffer_idx];
+    const Offset offset = offsets[buffer_idx];
+    if (buffer.offset && *buffer.offset != offset) return kBadFixed;
+    if (offset < 0) return kBadOffset;
+    if (offset + buffer.size > problem_.capacity) return kBadOffset;
+    if (offset % buffer.alignment != 0) return kBadAlignment;
+  }
+  // Any new overlap must involve at least one of the changed buffers.
+  for (const BufferIdx buffer_idx : buffer_idxs) {
+    const Offset offset = offsets[buffer_idx];
+    for (int64_t neighbor_idx = neighbor_starts_[buffer_idx];
+         neighbor_idx < neighbor_starts_[buffer_idx + 1]; ++neighbor_idx) {
+      const BufferIdx other_idx = neighbors_[neighbor_idx];
+      const auto it = offsets.find(other_idx);
+      const Offset other_offset =
+          it == offsets.end() ? solution_.offsets[other_idx] : it->second;
+      if (Overlaps(buffer_idx, offset, other_idx, other_offset)) {
+        return kBadOverlap;
+      }
+    }
+  }
+  return kGood;
+}
+
+ValidationResult IncrementalValidator::Apply(
+    const std::vector<OffsetChange>& changes) {
+  const ValidationResult result = Check(changes);
+  if (result != kGood) return result;
+  for (const OffsetChange& change : changes) {
+    solution_.offsets[change.buffer_idx] = change.offset;
   }
   return kGood;
 }
@@ -17,6 +17,9 @@ limitations under the License.
 #ifndef MINIMALLOC_SRC_VALIDATOR_H_
 #define MINIMALLOC_SRC_VALIDATOR_H_
 
+#include <optional>
+#include <vector>
+
 #include "minimalloc.h"
 #include "absl/base/attributes.h"
 
@@ -34,6 +37,71 @@ enum ValidationResult {
 ValidationResult Validate(
     const Problem& problem, const Solution& solution) ABSL_MUST_USE_RESULT;
 
+// A single problem found with a solution.  Overlaps name both buffers (with
+// buffer_idx < other_idx) and the period of time during which they collide.
+struct Violation {
+  ValidationResult kind = kGood;
+  BufferIdx buffer_idx = 0;
+  std::optional<BufferIdx> other_idx;
+  std::optional<Lifespan> lifespan;
+  bool operator==(const Violation& x) const;
+};
+
+struct ValidationReport {
+  ValidationResult result = kGood;  // The same result Validate would return.
+  std::vector<Violation> violations;  // Sorted by buffer, other, kind & time.
+};
+
+// Finds every violation in a solution rather than stopping at the first one.
+// The overlap check is sharded by time across the given number of threads.
+ValidationReport ValidateAll(const Problem& problem, const Solution& solution,
+                             int num_threads = 1) ABSL_MUST_USE_RESULT;
+
+struct OffsetChange {
+  BufferIdx buffer_idx = 0;
+  Offset offset = 0;
+};
+
+// Re-validates a handful of changes to a known-good solution.  Each buffer is
+// indexed alongside those it coexists with in time, so a set of changes can be
+// checked against the neighbors of the changed buffers alone, rather than the
+// whole problem.
+class IncrementalValidator {
+ public:
+  // The given solution is expected to be valid, eg. as reported by Validate.
+  IncrementalValidator(Problem problem, Solution solution);
+
+  const Problem& problem() const { return problem_; }
+  const Solution& solution() const { return solution_; }
+
+  // Returns the result Validate would give if the changes were made (with the
+  // last change taking precedence for any buffer that's listed twice).
+  ValidationResult Check(
+      const std::vector<OffsetChange>& changes) const ABSL_MUST_USE_RESULT;
+
+  // Makes the changes if (and only if) they leave the solution valid.
+  ValidationResult Apply(
+      const std::vector<OffsetChange>& changes) ABSL_MUST_USE_RESULT;
+
+ private:
+  // Determines whether two buffers (at the given offsets) overlap.
+  bool Overlaps(BufferIdx buffer_idx, Offset offset, BufferIdx other_idx,
+                Offset other_offset) const;
+
+  Problem problem_;
+  Solution solution_;
+
+  // The buffers that coexist in time with each buffer, stored contiguously.
+  std::vector<int64_t> neighbor_starts_;
+  std::vector<BufferIdx> neighbors_;
+
+  // The pieces of memory occupied by each buffer relative to its offset, in
+  // temporal order and stored contiguously.
+  std::vector<int64_t> piece_starts_;
+  std::vector<Lifespan> piece_lifespans_;
+  std::vector<Window> piece_windows_;
+};
+
 }  // namespace minimalloc
 
 #endif  // MINIMALLOC_SRC_VALIDATOR_H_
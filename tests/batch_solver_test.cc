@@ -0,0 +1,127 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "../src/batch_solver.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../src/minimalloc.h"
+#include "../src/solver.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "gtest/gtest.h"
+
+namespace minimalloc {
+namespace {
+
+std::vector<Problem> CreateProblems() {
+  return {
+      {.buffers = {{.lifespan = {0, 2}, .size = 2}}, .capacity = 2},
+      {.buffers = {{.lifespan = {0, 2}, .size = 2},
+                   {.lifespan = {1, 3}, .size = 1},
+                   {.lifespan = {0, 1}, .size = 1}},
+       .capacity = 3},
+      {.buffers = {{.lifespan = {0, 2}, .size = 2},
+                   {.lifespan = {0, 2}, .size = 2}},
+       .capacity = 3},
+  };
+}
+
+TEST(BatchSolverTest, StreamsResults) {
+  const std::vector<Problem> problems = CreateProblems();
+  const Solver solver;
+  std::vector<int64_t> problem_idxs;
+  SolveBatch(solver, problems, /*num_threads=*/1,
+             [&problem_idxs](BatchResult result) {
+               problem_idxs.push_back(result.problem_idx);
+               EXPECT_EQ(result.solution.ok(), result.problem_idx != 2);
+               EXPECT_GT(result.stats.nodes, 0);
+             });
+  // With a single thread, the largest problems are solved first.
+  EXPECT_EQ(problem_idxs, std::vector<int64_t>({1, 2, 0}));
+}
+
+TEST(BatchSolverTest, SolvesInParallel) {
+  std::vector<Problem> problems;
+  for (int copy = 0; copy < 10; ++copy) {
+    for (const Problem& problem : CreateProblems()) problems.push_back(problem);
+  }
+  const std::vector<absl::StatusOr<Solution>> solutions =
+      SolveBatch(Solver(), problems, /*num_threads=*/4);
+  ASSERT_EQ(solutions.size(), problems.size());
+  Solver solver;
+  for (int problem_idx = 0; problem_idx < problems.size(); ++problem_idx) {
+    const absl::StatusOr<Solution> expected = solver.Solve(problems[problem_idx]);
+    EXPECT_EQ(solutions[problem_idx].status(), expected.status());
+    if (expected.ok()) {
+      EXPECT_EQ(*solutions[problem_idx], *expected);
+    }
+  }
+}
+
+TEST(BatchSolverTest, ReadsManifest) {
+  const std::string dir = ::testing::TempDir() + "batch/";
+  std::filesystem::create_directories(dir);
+  std::ofstream(dir + "manifest.txt")
+      << "# A comment.\n"
+      << "a.csv, 16\n"
+      << "\n"
+      << "/abs/b.csv\n";
+  const absl::StatusOr<std::vector<BatchInput>> inputs =
+      ReadBatchManifest(dir + "manifest.txt", /*capacity=*/8);
+  ASSERT_TRUE(inputs.ok());
+  EXPECT_EQ(*inputs, std::vector<BatchInput>({
+      {.path = (std::filesystem::path(dir) / "a.csv").string(),
+       .capacity = 16},
+      {.path = "/abs/b.csv", .capacity = 8}}));
+  // Without a default, entries lacking a capacity keep that of their file.
+  const absl::StatusOr<std::vector<BatchInput>> defaultless =
+      ReadBatchManifest(dir + "manifest.txt", /*capacity=*/std::nullopt);
+  ASSERT_TRUE(defaultless.ok());
+  EXPECT_EQ(*defaultless, std::vector<BatchInput>({
+      {.path = (std::filesystem::path(dir) / "a.csv").string(),
+       .capacity = 16},
+      {.path = "/abs/b.csv"}}));
+  std::ofstream(dir + "bad.txt") << "a.csv,big\n";
+  EXPECT_EQ(ReadBatchManifest(dir + "bad.txt", 8).status().code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(ReadBatchManifest(dir + "missing.txt", 8).status().code(),
+            absl::StatusCode::kNotFound);
+}
+
+TEST(BatchSolverTest, ListsDirectory) {
+  const std::string dir = ::testing::TempDir() + "batch_dir/";
+  std::filesystem::create_directories(dir + "nested");
+  std::ofstream(dir + "b.csv");
+  std::ofstream(dir + "a.csv");
+  const absl::StatusOr<std::vector<BatchInput>> inputs =
+      ListBatchInputs(dir, /*capacity=*/4);
+  ASSERT_TRUE(inputs.ok());
+  EXPECT_EQ(*inputs, std::vector<BatchInput>({
+      {.path = (std::filesystem::path(dir) / "a.csv").string(), .capacity = 4},
+      {.path = (std::filesystem::path(dir) / "b.csv").string(), .capacity = 4},
+  }));
+  EXPECT_EQ(ListBatchInputs(dir + "missing", 4).status().code(),
+            absl::StatusCode::kNotFound);
+}
+
+}  // namespace
+}  // namespace minimalloc
@@ -0,0 +1,176 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "../src/c_api.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(CApiTest, SolvesProblem) {
+  const int64_t lowers[] = {0, 3, 0, 9, 0};
+  const int64_t uppers[] = {3, 9, 9, 21, 21};
+  const int64_t sizes[] = {4, 4, 4, 4, 4};
+  mm_problem* problem =
+      mm_problem_create(5, lowers, uppers, sizes, nullptr, 12);
+  ASSERT_NE(problem, nullptr);
+  mm_solver* solver = mm_solver_create(nullptr);
+  ASSERT_NE(solver, nullptr);
+  mm_solution* solution = nullptr;
+  EXPECT_EQ(mm_solve(solver, problem, &solution), MM_OK);
+  ASSERT_NE(solution, nullptr);
+  int64_t num_offsets = 0;
+  const int64_t* offsets = mm_solution_get_offsets(solution, &num_offsets);
+  EXPECT_EQ(std::vector<int64_t>(offsets, offsets + num_offsets),
+            std::vector<int64_t>({8, 8, 4, 4, 0}));
+  mm_solver_stats stats;
+  EXPECT_EQ(mm_solver_get_stats(solver, &stats), MM_OK);
+  EXPECT_GT(stats.nodes, 0);
+  mm_solution_destroy(solution);
+  mm_solver_destroy(solver);
+  mm_problem_destroy(problem);
+}
+
+TEST(CApiTest, SolvesWithGapsAndFixedOffsets) {
+  const int64_t lowers[] = {0, 5, 0};
+  const int64_t uppers[] = {10, 15, 15};
+  const int64_t sizes[] = {2, 2, 1};
+  const int64_t alignments[] = {1, 1, 1};
+  mm_problem* problem =
+      mm_problem_create(3, lowers, uppers, sizes, alignments, 3);
+  ASSERT_NE(problem, nullptr);
+  EXPECT_EQ(mm_problem_add_gap(problem, 0, 1, 9, 0, 0, 0), MM_OK);
+  EXPECT_EQ(mm_problem_add_gap(problem, 1, 6, 14, 0, 0, 0), MM_OK);
+  EXPECT_EQ(mm_problem_set_fixed_offset(problem, 2, 2), MM_OK);
+  mm_solver* solver = mm_solver_create(nullptr);
+  mm_solution* solution = nullptr;
+  EXPECT_EQ(mm_solve(solver, problem, &solution), MM_OK);
+  int64_t num_offsets = 0;
+  const int64_t* offsets = mm_solution_get_offsets(solution, &num_offsets);
+  EXPECT_EQ(std::vector<int64_t>(offsets, offsets + num_offsets),
+            std::vector<int64_t>({0, 0, 2}));
+  mm_solution_destroy(solution);
+  mm_solver_destroy(solver);
+  mm_problem_destroy(problem);
+}
+
+TEST(CApiTest, SolvesWithContext) {
+  const int64_t lowers[] = {0, 0};
+  const int64_t uppers[] = {2, 2};
+  const int64_t sizes[] = {1, 2};
+  mm_problem* problem = mm_problem_create(2, lowers, uppers, sizes, nullptr, 3);
+  mm_solver* solver = mm_solver_create(nullptr);
+  mm_context* context = mm_context_create();
+  ASSERT_NE(context, nullptr);
+  mm_solution* solution = nullptr;
+  EXPECT_EQ(mm_solve_with_context(solver, context, problem, &solution), MM_OK);
+  mm_solver_stats stats;
+  EXPECT_EQ(mm_context_get_stats(context, &stats), MM_OK);
+  EXPECT_GT(stats.nodes, 0);
+  mm_solution_destroy(solution);
+  mm_context_cancel(context);
+  solution = nullptr;
+  EXPECT_EQ(mm_solve_with_context(solver, context, problem, &solution),
+            MM_DEADLINE_EXCEEDED);
+  EXPECT_EQ(solution, nullptr);
+  mm_context_destroy(context);
+  mm_solver_destroy(solver);
+  mm_problem_destroy(problem);
+}
+
+TEST(CApiTest, ReportsInfeasibility) {
+  const int64_t lowers[] = {0, 0};
+  const int64_t uppers[] = {2, 2};
+  const int64_t sizes[] = {2, 2};
+  mm_problem* problem = mm_problem_create(2, lowers, uppers, sizes, nullptr, 3);
+  mm_solver_params params;
+  mm_solver_params_init(&params);
+  params.preordering_heuristics = "WAT";
+  mm_solver* solver = mm_solver_create(&params);
+  ASSERT_NE(solver, nullptr);
+  mm_solution* solution = nullptr;
+  EXPECT_EQ(mm_solve(solver, problem, &solution), MM_NOT_FOUND);
+  EXPECT_EQ(solution, nullptr);
+  mm_solver_destroy(solver);
+  mm_problem_destroy(problem);
+}
+
+TEST(CApiTest, HonorsStructSize) {
+  const int64_t lowers[] = {0, 0};
+  const int64_t uppers[] = {2, 2};
+  const int64_t sizes[] = {2, 2};
+  mm_problem* problem = mm_problem_create(2, lowers, uppers, sizes, nullptr, 4);
+  mm_solver_params params;
+  mm_solver_params_init(&params);
+  EXPECT_EQ(params.struct_size, sizeof(mm_solver_params));
+  params.small_partition_search = 0;
+  params.dense_overlaps = 1;
+  mm_solver* solver = mm_solver_create(&params);
+  ASSERT_NE(solver, nullptr);
+  mm_solution* solution = nullptr;
+  EXPECT_EQ(mm_solve(solver, problem, &solution), MM_OK);
+  mm_solution_destroy(solution);
+  mm_solver_destroy(solver);
+  // A caller built against an older header leaves the newer fields defaulted.
+  params.struct_size = offsetof(mm_solver_params, deduplicate_partitions);
+  solver = mm_solver_create(&params);
+  ASSERT_NE(solver, nullptr);
+  mm_solver_destroy(solver);
+  params.struct_size = 0;
+  EXPECT_EQ(mm_solver_create(&params), nullptr);
+  mm_problem_destroy(problem);
+}
+
+TEST(CApiTest, CatchesExceptions) {
+  const int64_t lowers[] = {0};
+  const int64_t uppers[] = {2};
+  const int64_t sizes[] = {2};
+  // Reserving this many buffers throws, which mustn't escape into C.
+  EXPECT_EQ(mm_problem_create(int64_t{1} << 62, lowers, uppers, sizes, nullptr,
+                              2),
+            nullptr);
+}
+
+TEST(CApiTest, RejectsBadArguments) {
+  const int64_t lowers[] = {0};
+  const int64_t uppers[] = {2};
+  const int64_t sizes[] = {2};
+  const int64_t bad_alignments[] = {0};
+  EXPECT_EQ(mm_problem_create(1, nullptr, uppers, sizes, nullptr, 2), nullptr);
+  EXPECT_EQ(mm_problem_create(1, uppers, lowers, sizes, nullptr, 2), nullptr);
+  EXPECT_EQ(mm_problem_create(1, lowers, uppers, sizes, bad_alignments, 2),
+            nullptr);
+  EXPECT_EQ(mm_problem_create(-1, lowers, uppers, sizes, nullptr, 2), nullptr);
+  mm_problem* problem = mm_problem_create(1, lowers, uppers, sizes, nullptr, 2);
+  ASSERT_NE(problem, nullptr);
+  EXPECT_EQ(mm_problem_add_gap(problem, 1, 0, 1, 0, 0, 0),
+            MM_INVALID_ARGUMENT);
+  EXPECT_EQ(mm_problem_add_gap(problem, 0, 0, 3, 0, 0, 0),
+            MM_INVALID_ARGUMENT);
+  EXPECT_EQ(mm_problem_add_gap(problem, 0, 0, 1, 1, 0, 3),
+            MM_INVALID_ARGUMENT);
+  EXPECT_EQ(mm_problem_set_fixed_offset(problem, -1, 0), MM_INVALID_ARGUMENT);
+  EXPECT_EQ(mm_solve(nullptr, problem, nullptr), MM_INVALID_ARGUMENT);
+  EXPECT_EQ(mm_solver_get_stats(nullptr, nullptr), MM_INVALID_ARGUMENT);
+  EXPECT_EQ(mm_solution_get_offsets(nullptr, nullptr), nullptr);
+  mm_problem_destroy(problem);
+}
+
+}  // namespace
@@ -16,10 +16,19 @@ limitations under the License.
 
 #include "../src/converter.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
 #include "../src/minimalloc.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 
 namespace minimalloc {
 namespace {
@@ -178,6 +187,48 @@ TEST(ConverterTest, ToCsvOldFormat) {
       "Little,5,9,15,1,\nBig,6,11,18,2,7-7 9-9\n");
 }
 
+TEST(ConverterTest, WriteCsvLargeProblem) {
+  Problem problem;
+  std::string expected = "id,lower,upper,size,gaps,offset\n";
+  Solution solution;
+  for (int buffer_idx = 0; buffer_idx < 10000; ++buffer_idx) {
+    problem.buffers.push_back({.id = absl::StrCat("b", buffer_idx),
+                               .lifespan = {buffer_idx, buffer_idx + 10},
+                               .size = 1000000 + buffer_idx,
+                               .gaps = {{.lifespan = {buffer_idx + 1,
+                                                      buffer_idx + 2}}}});
+    solution.offsets.push_back(-buffer_idx);
+    absl::StrAppend(&expected, "b", buffer_idx, ",", buffer_idx, ",",
+                    buffer_idx + 10, ",", 1000000 + buffer_idx, ",",
+                    buffer_idx + 1, "-", buffer_idx + 2, ",", -buffer_idx,
+                    "\n");
+  }
+  std::ostringstream oss;
+  EXPECT_TRUE(WriteCsv(problem, oss, &solution).ok());
+  EXPECT_EQ(oss.str(), expected);
+  EXPECT_EQ(ToCsv(problem, &solution), expected);
+}
+
+TEST(ConverterTest, WriteCsvFileDescriptor) {
+  const std::string path = ::testing::TempDir() + "written.csv";
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  ASSERT_GE(fd, 0);
+  const Problem problem = {
+    .buffers = {{.id = "0", .lifespan = {5, 10}, .size = 15}},
+  };
+  EXPECT_TRUE(WriteCsv(problem, fd).ok());
+  close(fd);
+  std::ifstream ifs(path);
+  std::stringstream contents;
+  contents << ifs.rdbuf();
+  EXPECT_EQ(contents.str(), "id,lower,upper,size\n0,5,10,15\n");
+}
+
+TEST(ConverterTest, WriteCsvBadStream) {
+  std::ofstream ofs;  // Never opened.
+  EXPECT_FALSE(WriteCsv({.buffers = {{.id = "0"}}}, ofs).ok());
+}
+
 TEST(ConverterTest, FromCsvProblemOnly) {
   EXPECT_EQ(
       *FromCsv("lower,size,id,upper\n6,18,1,12\n5,15,0,10\n"),
@@ -323,6 +374,160 @@ TEST(ConverterTest, FromCsvStringIDs) {
       }));
 }
 
+TEST(ConverterTest, FromCsvWhitespaceAndSigns) {
+  EXPECT_THAT(
+      *FromCsv("start,size,buffer,upper,offset\n 6,+18,Big,12 ,21\r\n"),
+      (Problem{
+        .buffers = {
+            {.id = "Big", .lifespan = {6, 12}, .size = 18, .offset = 21},
+        },
+      }));
+}
+
+TEST(ConverterTest, FromCsvFile) {
+  const std::string path = ::testing::TempDir() + "problem.csv";
+  std::ofstream(path) << "lower,size,id,upper\n6,18,1,12\n5,15,0,10\n";
+  EXPECT_EQ(
+      *FromCsvFile(path),
+      (Problem{
+        .buffers = {
+            {.id = "1", .lifespan = {6, 12}, .size = 18},
+            {.id = "0", .lifespan = {5, 10}, .size = 15},
+        },
+      }));
+}
+
+TEST(ConverterTest, FromCsvFileMissing) {
+  EXPECT_EQ(FromCsvFile(::testing::TempDir() + "missing.csv").status().code(),
+            absl::StatusCode::kNotFound);
+}
+
+TEST(ConverterTest, BinaryRoundTrip) {
+  const Problem problem = {
+    .buffers = {
+        {.id = "Little", .lifespan = {5, 10}, .size = 15, .hint = 4},
+        {.id = "", .lifespan = {6, 12}, .size = 18, .alignment = 2,
+         .offset = 3},
+        {.id = "Big", .lifespan = {6, 12}, .size = 18, .alignment = 2,
+         .gaps = {{.lifespan = {7, 8}},
+                  {.lifespan = {9, 10}, .window = {{0, 3}}}}},
+    },
+    .capacity = 40
+  };
+  absl::StatusOr<Problem> round_trip = FromBinary(ToBinary(problem));
+  ASSERT_TRUE(round_trip.ok());
+  EXPECT_EQ(*round_trip, problem);
+  EXPECT_EQ(round_trip->buffers[0].hint, 4);
+}
+
+TEST(ConverterTest, BinaryWithSolution) {
+  const Problem problem = {
+    .buffers = {
+        {.id = "0", .lifespan = {5, 10}, .size = 15},
+        {.id = "1", .lifespan = {6, 12}, .size = 18},
+    },
+    .capacity = 40
+  };
+  Solution solution = {.offsets = {0, 15}};
+  absl::StatusOr<Problem> round_trip =
+      FromBinary(ToBinary(problem, &solution));
+  ASSERT_TRUE(round_trip.ok());
+  EXPECT_EQ(round_trip->strip_solution()->offsets, solution.offsets);
+  EXPECT_EQ(*round_trip, problem);
+}
+
+TEST(ConverterTest, BinaryView) {
+  const Problem problem = {
+    .buffers = {
+        {.id = "a", .lifespan = {5, 10}, .size = 15},
+        {.id = "bc", .lifespan = {6, 12}, .size = 18,
+         .gaps = {{.lifespan = {7, 8}, .window = {{1, 2}}}}},
+    },
+  };
+  const std::string binary = ToBinary(problem);
+  absl::StatusOr<BinaryView> view = BinaryView::Create(binary);
+  ASSERT_TRUE(view.ok());
+  EXPECT_EQ(view->num_buffers(), 2);
+  EXPECT_EQ(view->id(1), "bc");
+  EXPECT_EQ(view->sizes()[1], 18);
+  EXPECT_EQ(view->offsets()[0], BinaryView::kNoValue);
+  EXPECT_EQ(view->gap_range(1), Interval<int64_t>({0, 1}));
+  EXPECT_EQ(view->window_uppers()[0], 2);
+}
+
+TEST(ConverterTest, BinaryFile) {
+  const Problem problem = {
+    .buffers = {{.id = "0", .lifespan = {5, 10}, .size = 15}},
+    .capacity = 15
+  };
+  const std::string path = ::testing::TempDir() + "problem.bin";
+  std::ofstream(path, std::ios::binary) << ToBinary(problem);
+  EXPECT_EQ(*FromBinaryFile(path), problem);
+}
+
+TEST(ConverterTest, BogusBinary) {
+  const std::string binary = ToBinary({.buffers = {{.id = "0"}}});
+  EXPECT_EQ(FromBinary("").status().code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(FromBinary(binary.substr(0, binary.size() - 8)).status().code(),
+            absl::StatusCode::kInvalidArgument);
+  std::string bad_magic = binary;
+  bad_magic[0] = 'X';
+  EXPECT_EQ(FromBinary(bad_magic).status().code(),
+            absl::StatusCode::kInvalidArgument);
+  std::string bad_version = binary;
+  bad_version[8] = 2;
+  EXPECT_EQ(FromBinary(bad_version).status().code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+// Creates a CSV large enough to be split into many chunks.
+std::string CreateLargeCsv(int num_buffers) {
+  std::string csv = "buffer_id,start,end,size,gaps\n";
+  for (int buffer_idx = 0; buffer_idx < num_buffers; ++buffer_idx) {
+    absl::StrAppend(&csv, "b", buffer_idx, ",", buffer_idx, ",",
+                    buffer_idx + 9, ",", buffer_idx % 7 + 1, ",",
+                    buffer_idx + 1, "-", buffer_idx + 2, "\n");
+  }
+  return csv;
+}
+
+TEST(ConverterTest, FromCsvParallel) {
+  const std::string csv = CreateLargeCsv(100000);
+  const absl::StatusOr<Problem> expected = FromCsv(csv);
+  ASSERT_TRUE(expected.ok());
+  EXPECT_EQ(expected->buffers.size(), 100000);
+  EXPECT_EQ(expected->buffers[5].lifespan, Lifespan({5, 15}));
+  for (int num_threads : {1, 2, 3, 8}) {
+    const absl::StatusOr<Problem> problem = FromCsv(csv, num_threads);
+    ASSERT_TRUE(problem.ok());
+    EXPECT_EQ(*problem, *expected);
+  }
+}
+
+TEST(ConverterTest, FromCsvParallelErrors) {
+  const std::string csv = CreateLargeCsv(100000);
+  std::string bogus = csv;
+  bogus.replace(bogus.size() - 10, 1, "x");
+  EXPECT_EQ(FromCsv(bogus, 4).status().code(),
+            absl::StatusCode::kInvalidArgument);
+  // Records following an empty one are ignored (even if they're malformed).
+  const size_t newline = bogus.find('\n', bogus.size() / 3);
+  bogus.insert(newline, "\n");
+  const absl::StatusOr<Problem> expected = FromCsv(bogus);
+  const absl::StatusOr<Problem> problem = FromCsv(bogus, 4);
+  ASSERT_TRUE(expected.ok());
+  ASSERT_TRUE(problem.ok());
+  EXPECT_EQ(*problem, *expected);
+  EXPECT_LT(problem->buffers.size(), 50000);
+}
+
+TEST(ConverterTest, FromCsvParallelMissingColumn) {
+  std::string csv = CreateLargeCsv(100000);
+  csv.replace(0, csv.find(','), "name");
+  EXPECT_EQ(FromCsv(csv, 4).status().code(), absl::StatusCode::kNotFound);
+}
+
 TEST(ConverterTest, BogusInputs) {
   EXPECT_EQ(
       FromCsv("start,size,buffer,upper\n"
@@ -0,0 +1,119 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "../src/generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../src/minimalloc.h"
+#include "../src/sweeper.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "gtest/gtest.h"
+
+namespace minimalloc {
+namespace {
+
+TEST(GeneratorTest, Reproducible) {
+  const GeneratorParams params = {.num_buffers = 500, .gap_density = 1.5,
+                                  .seed = 7};
+  const absl::StatusOr<Problem> problem = Generate(params);
+  ASSERT_TRUE(problem.ok());
+  EXPECT_EQ(*problem, *Generate(params));
+  GeneratorParams other_params = params;
+  other_params.seed = 8;
+  EXPECT_NE(*problem, *Generate(other_params));
+}
+
+TEST(GeneratorTest, RespectsParams) {
+  const GeneratorParams params = {
+      .num_buffers = 1000,
+      .num_partitions = 4,
+      .min_length = 5,
+      .max_length = 20,
+      .min_size = 16,
+      .max_size = 64,
+      .size_skew = 2.0,
+      .alignments = {{.alignment = 1, .weight = 1},
+                     {.alignment = 8, .weight = 1},
+                     {.alignment = 4, .weight = 0}},
+      .gap_density = 2.0,
+      .window_probability = 0.5,
+  };
+  const absl::StatusOr<Problem> problem = Generate(params);
+  ASSERT_TRUE(problem.ok());
+  ASSERT_EQ(problem->buffers.size(), 1000);
+  int num_aligned = 0;
+  for (const Buffer& buffer : problem->buffers) {
+    const TimeValue length = buffer.lifespan.upper() - buffer.lifespan.lower();
+    EXPECT_GE(length, 5);
+    EXPECT_LE(length, 20);
+    EXPECT_GE(buffer.size, 16);
+    EXPECT_LE(buffer.size, 64);
+    EXPECT_TRUE(buffer.alignment == 1 || buffer.alignment == 8);
+    if (buffer.alignment == 8) ++num_aligned;
+    EXPECT_EQ(buffer.gaps.size(), std::min<int64_t>(2, length / 3));
+    TimeValue time = buffer.lifespan.lower();
+    for (const Gap& gap : buffer.gaps) {
+      EXPECT_LT(time, gap.lifespan.lower());
+      EXPECT_LT(gap.lifespan.lower(), gap.lifespan.upper());
+      time = gap.lifespan.upper();
+      if (!gap.window) continue;
+      EXPECT_GE(gap.window->lower(), 0);
+      EXPECT_LT(gap.window->lower(), gap.window->upper());
+      EXPECT_LE(gap.window->upper(), buffer.size);
+    }
+    EXPECT_LT(time, buffer.lifespan.upper());
+  }
+  EXPECT_GT(num_aligned, 400);
+  EXPECT_LT(num_aligned, 600);
+  EXPECT_GE(Sweep(*problem).partitions.size(), 4);
+}
+
+TEST(GeneratorTest, Tightness) {
+  const absl::StatusOr<Problem> problem =
+      Generate({.num_buffers = 200, .gap_density = 0.5, .tightness = 0.8});
+  ASSERT_TRUE(problem.ok());
+  const int64_t lower_bound = ComputeLowerBound(*problem);
+  EXPECT_EQ(problem->capacity, std::ceil(lower_bound / 0.8));
+  const std::vector<int64_t> totals = Sweep(*problem).CalculateTotals();
+  EXPECT_EQ(lower_bound, *std::max_element(totals.begin(), totals.end()));
+}
+
+TEST(GeneratorTest, BadParams) {
+  EXPECT_EQ(Generate({.num_buffers = -1}).status().code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(Generate({.num_partitions = 0}).status().code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(Generate({.min_length = 10, .max_length = 5}).status().code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(Generate({.horizon = 10}).status().code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(Generate({.min_size = 0}).status().code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(Generate({.alignments = {}}).status().code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(Generate({.window_probability = 2}).status().code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(Generate({.tightness = 0}).status().code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+}  // namespace
+}  // namespace minimalloc
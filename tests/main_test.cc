@@ -0,0 +1,97 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Runs the minimalloc binary itself, so as to cover its command-line handling.
+
+#include <sys/wait.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "../src/converter.h"
+#include "../src/minimalloc.h"
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace minimalloc {
+namespace {
+
+// Returns the exit code of the minimalloc binary run with the given flags.
+int RunMinimalloc(const std::string& flags) {
+  const int status = std::system(
+      absl::StrCat(MINIMALLOC_BINARY, " ", flags, " 2>/dev/null").c_str());
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// Writes a binary problem that is feasible only with a capacity of at least 4.
+std::string WriteBinaryProblem(const std::string& dir) {
+  const Problem problem = {
+      .buffers = {{.lifespan = {0, 2}, .size = 2},
+                  {.lifespan = {1, 3}, .size = 2}},
+      .capacity = 4};
+  std::filesystem::create_directories(dir);
+  const std::string path = dir + "problem.bin";
+  std::ofstream(path, std::ios::binary) << ToBinary(problem);
+  return path;
+}
+
+TEST(MainTest, KeepsCapacityOfBinaryInput) {
+  const std::string dir = ::testing::TempDir() + "main_single/";
+  const std::string input = WriteBinaryProblem(dir);
+  const std::string flags = absl::StrCat("--input_format=binary --input=",
+                                         input, " --output=", dir, "out.csv");
+  EXPECT_EQ(RunMinimalloc(flags), 0);
+  // An explicit --capacity still overrides that of the file.
+  EXPECT_NE(RunMinimalloc(absl::StrCat(flags, " --capacity=3")), 0);
+  EXPECT_EQ(RunMinimalloc(absl::StrCat(flags, " --capacity=4")), 0);
+}
+
+TEST(MainTest, KeepsCapacityOfBinaryBatchInput) {
+  const std::string dir = ::testing::TempDir() + "main_batch/";
+  const std::string input = WriteBinaryProblem(dir);
+  std::ofstream(dir + "manifest.txt") << input << "\n";
+  const std::string flags = absl::StrCat(
+      "--input_format=binary --manifest=", dir, "manifest.txt > /dev/null");
+  EXPECT_EQ(RunMinimalloc(flags), 0);
+  EXPECT_NE(RunMinimalloc(absl::StrCat("--capacity=3 ", flags)), 0);
+  std::ofstream(dir + "manifest.txt") << input << ",3\n";
+  EXPECT_NE(RunMinimalloc(flags), 0);
+}
+
+TEST(MainTest, RejectsCollidingBatchOutputs) {
+  const std::string dir = ::testing::TempDir() + "main_collide/";
+  const std::string input = WriteBinaryProblem(dir + "a/");
+  std::filesystem::create_directories(dir + "b/");
+  std::filesystem::copy_file(
+      input, dir + "b/problem.bin",
+      std::filesystem::copy_options::overwrite_existing);
+  std::ofstream(dir + "manifest.txt") << "a/problem.bin\nb/problem.bin\n";
+  const std::string flags = absl::StrCat(
+      "--input_format=binary --manifest=", dir, "manifest.txt --output_dir=",
+      dir, "out > /dev/null");
+  std::filesystem::remove_all(dir + "out");
+  std::filesystem::create_directories(dir + "out");
+  EXPECT_NE(RunMinimalloc(flags), 0);
+  EXPECT_TRUE(std::filesystem::is_empty(dir + "out"));
+  std::ofstream(dir + "manifest.txt") << "a/problem.bin\n";
+  EXPECT_EQ(RunMinimalloc(flags), 0);
+  EXPECT_TRUE(std::filesystem::exists(dir + "out/problem.bin"));
+}
+
+}  // namespace
+}  // namespace minimalloc
@@ -0,0 +1,58 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "../src/mapped_file.h"
+
+#include <fstream>
+#include <string>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+
+namespace minimalloc {
+namespace {
+
+std::string WriteFile(const std::string& name, const std::string& contents) {
+  const std::string path = ::testing::TempDir() + name;
+  std::ofstream(path) << contents;
+  return path;
+}
+
+TEST(MappedFileTest, ReadsContents) {
+  const std::string path = WriteFile("mapped", "id,lower,upper,size\n");
+  auto mapped_file = MappedFile::Open(path);
+  ASSERT_TRUE(mapped_file.ok());
+  EXPECT_EQ(mapped_file->contents(), "id,lower,upper,size\n");
+  MappedFile moved = std::move(*mapped_file);
+  EXPECT_EQ(moved.contents(), "id,lower,upper,size\n");
+  EXPECT_TRUE(mapped_file->contents().empty());
+}
+
+TEST(MappedFileTest, EmptyFile) {
+  const std::string path = WriteFile("mapped_empty", "");
+  auto mapped_file = MappedFile::Open(path);
+  ASSERT_TRUE(mapped_file.ok());
+  EXPECT_TRUE(mapped_file->contents().empty());
+}
+
+TEST(MappedFileTest, MissingFile) {
+  EXPECT_EQ(MappedFile::Open(::testing::TempDir() + "missing").status().code(),
+            absl::StatusCode::kNotFound);
+}
+
+}  // namespace
+}  // namespace minimalloc
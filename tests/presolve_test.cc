@@ -0,0 +1,96 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "../src/presolve.h"
+
+#include <vector>
+
+#include "../src/minimalloc.h"
+#include "gtest/gtest.h"
+
+namespace minimalloc {
+namespace {
+
+TEST(PresolveTest, FindsPreviousEquivalents) {
+  const Problem problem = {
+    .buffers = {
+        {.id = "a", .lifespan = {0, 4}, .size = 2},
+        {.id = "b", .lifespan = {0, 4}, .size = 2},
+        {.id = "c", .lifespan = {0, 4}, .size = 2, .alignment = 2},
+        {.id = "d", .lifespan = {0, 4}, .size = 2},
+        {.id = "e", .lifespan = {0, 4}, .size = 3},
+        {.id = "f", .lifespan = {0, 4}, .size = 2, .offset = 0},
+        {.id = "g", .lifespan = {0, 4}, .size = 2, .alignment = 2},
+        {.id = "h", .lifespan = {0, 4}, .size = 2,
+         .gaps = {{.lifespan = {1, 2}}}},
+        {.id = "i", .lifespan = {0, 4}, .size = 2,
+         .gaps = {{.lifespan = {1, 2}}}},
+        {.id = "j", .lifespan = {0, 4}, .size = 2,
+         .gaps = {{.lifespan = {1, 2}, .window = {{0, 1}}}}},
+    },
+    .capacity = 100
+  };
+  EXPECT_EQ(FindPreviousEquivalents(problem),
+            std::vector<BufferIdx>({-1, 0, -1, 1, -1, -1, 2, -1, 7, -1}));
+}
+
+TEST(PresolveTest, IgnoresBuffersThatNeedNotOverlap) {
+  const Problem problem = {
+    .buffers = {
+        {.lifespan = {0, 4}, .size = 0},
+        {.lifespan = {0, 4}, .size = 0},
+        {.lifespan = {0, 4}, .size = 2,
+         .gaps = {{.lifespan = {0, 2}}, {.lifespan = {2, 4}}}},
+        {.lifespan = {0, 4}, .size = 2,
+         .gaps = {{.lifespan = {0, 2}}, {.lifespan = {2, 4}}}},
+    },
+    .capacity = 100
+  };
+  EXPECT_EQ(FindPreviousEquivalents(problem),
+            std::vector<BufferIdx>({-1, -1, -1, -1}));
+}
+
+TEST(PresolveTest, ComputesScale) {
+  Problem problem = {
+    .buffers = {
+        {.lifespan = {0, 4}, .size = 12, .alignment = 4},
+        {.lifespan = {1, 5}, .size = 24, .alignment = 8,
+         .gaps = {{.lifespan = {2, 3}, .window = {{4, 16}}}}, .hint = 6},
+        {.lifespan = {2, 6}, .size = 8, .offset = 16},
+    },
+    .capacity = 50
+  };
+  EXPECT_EQ(ComputeScale(problem), 4);
+  const Problem expected = {
+    .buffers = {
+        {.lifespan = {0, 4}, .size = 3, .alignment = 1},
+        {.lifespan = {1, 5}, .size = 6, .alignment = 2,
+         .gaps = {{.lifespan = {2, 3}, .window = {{1, 4}}}}, .hint = 1},
+        {.lifespan = {2, 6}, .size = 2, .alignment = 1, .offset = 4},
+    },
+    .capacity = 12
+  };
+  EXPECT_EQ(ScaleDown(problem, 4), expected);
+  problem.buffers[2].alignment = 6;  // Neither divides nor is divided by 4.
+  EXPECT_EQ(ComputeScale(problem), 2);
+  problem.buffers[2].alignment = 1;
+  problem.buffers[2].offset = 18;
+  EXPECT_EQ(ComputeScale(problem), 2);
+  EXPECT_EQ(ComputeScale(Problem()), 1);
+}
+
+}  // namespace
+}  // namespace minimalloc
@@ -0,0 +1,178 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "../src/server.h"
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/converter.h"
+#include "../src/minimalloc.h"
+#include "../src/solver.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "gtest/gtest.h"
+
+namespace minimalloc {
+namespace {
+
+// Runs a server on a background thread for the duration of a test.
+class ServerTest : public ::testing::Test {
+ protected:
+  void StartServer(const SolverParams& params = SolverParams()) {
+    socket_path_ = ::testing::TempDir() + "minimalloc_server_test.sock";
+    absl::StatusOr<std::unique_ptr<Server>> server =
+        Server::Create(socket_path_, params, /*num_threads=*/2);
+    ASSERT_TRUE(server.ok()) << server.status();
+    server_ = *std::move(server);
+    serve_thread_ = std::thread([this]() { server_->Serve(); });
+    absl::StatusOr<int> fd = ConnectToServer(socket_path_);
+    ASSERT_TRUE(fd.ok()) << fd.status();
+    fd_ = *fd;
+  }
+
+  void TearDown() override {
+    if (fd_ >= 0) close(fd_);
+    if (!server_) return;
+    server_->Shutdown();
+    serve_thread_.join();
+  }
+
+  SolveResponse Receive() {
+    absl::StatusOr<std::string> payload = ReadFrame(fd_);
+    EXPECT_TRUE(payload.ok()) << payload.status();
+    absl::StatusOr<SolveResponse> response = DecodeSolveResponse(*payload);
+    EXPECT_TRUE(response.ok()) << response.status();
+    return *std::move(response);
+  }
+
+  std::string socket_path_;
+  std::unique_ptr<Server> server_;
+  std::thread serve_thread_;
+  int fd_ = -1;
+};
+
+TEST_F(ServerTest, SolvesCsvAndBinary) {
+  StartServer();
+  const Problem problem = {
+    .buffers = {
+        {.lifespan = {0, 2}, .size = 2},
+        {.lifespan = {1, 3}, .size = 1},
+    },
+    .capacity = 3
+  };
+  ASSERT_TRUE(WriteFrame(fd_, EncodeSolveRequest(
+      7, kCsvFormat, 3, "id,lower,upper,size\n0,0,2,2\n1,1,3,1\n")).ok());
+  SolveResponse response = Receive();
+  EXPECT_EQ(response.request_id, 7);
+  ASSERT_TRUE(response.solution.ok()) << response.solution.status();
+  EXPECT_EQ(response.solution->offsets, std::vector<Offset>({0, 2}));
+  EXPECT_GT(response.stats.nodes, 0);
+
+  ASSERT_TRUE(WriteFrame(fd_, EncodeSolveRequest(
+      8, kBinaryFormat, 3, ToBinary(problem))).ok());
+  response = Receive();
+  EXPECT_EQ(response.request_id, 8);
+  ASSERT_TRUE(response.solution.ok()) << response.solution.status();
+  EXPECT_EQ(response.solution->offsets, std::vector<Offset>({0, 2}));
+}
+
+TEST_F(ServerTest, ReportsErrors) {
+  StartServer();
+  ASSERT_TRUE(WriteFrame(fd_, EncodeSolveRequest(
+      1, kCsvFormat, 3, "id,lower,upper,size\n0,0,2,2\n1,0,2,2\n")).ok());
+  EXPECT_EQ(Receive().solution.status().code(), absl::StatusCode::kNotFound);
+  ASSERT_TRUE(WriteFrame(fd_, EncodeSolveRequest(
+      2, kCsvFormat, 3, "id,lower,upper,size\n0,0,x,2\n")).ok());
+  EXPECT_EQ(Receive().solution.status().code(),
+            absl::StatusCode::kInvalidArgument);
+  ASSERT_TRUE(WriteFrame(fd_, EncodeSolveRequest(
+      3, static_cast<RequestFormat>(5), 3, "")).ok());
+  EXPECT_EQ(Receive().solution.status().code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST_F(ServerTest, CancelsSolve) {
+  // Without any pruning, this infeasible problem would take ages to solve.
+  StartServer({.canonical_only = false,
+               .section_inference = false,
+               .dynamic_ordering = false,
+               .check_dominance = false,
+               .unallocated_floor = false,
+               .static_preordering = false,
+               .dynamic_decomposition = false,
+               .monotonic_floor = false,
+               .hatless_pruning = false,
+               .preordering_heuristics = {"TWA"}});
+  Problem problem;
+  for (int64_t size = 1; size <= 20; ++size) {
+    problem.buffers.push_back({.lifespan = {0, 1}, .size = size});
+  }
+  ASSERT_TRUE(WriteFrame(fd_, EncodeSolveRequest(
+      1, kBinaryFormat, 209, ToBinary(problem))).ok());
+  ASSERT_TRUE(WriteFrame(fd_, EncodeCancelRequest(1)).ok());
+  const SolveResponse response = Receive();
+  EXPECT_EQ(response.request_id, 1);
+  EXPECT_EQ(response.solution.status().code(),
+            absl::StatusCode::kDeadlineExceeded);
+}
+
+TEST_F(ServerTest, ClosesConnectionOnOversizedFrame) {
+  StartServer();
+  // A header claiming a 2^62-byte payload, which is never sent.
+  std::string header(8, '\0');
+  header[7] = 0x40;
+  ASSERT_EQ(write(fd_, header.data(), header.size()),
+            static_cast<ssize_t>(header.size()));
+  EXPECT_EQ(ReadFrame(fd_).status().code(), absl::StatusCode::kOutOfRange);
+  // The server itself keeps serving other connections.
+  absl::StatusOr<int> fd = ConnectToServer(socket_path_);
+  ASSERT_TRUE(fd.ok()) << fd.status();
+  close(fd_);
+  fd_ = *fd;
+  ASSERT_TRUE(WriteFrame(fd_, EncodeSolveRequest(
+      1, kCsvFormat, 3, "id,lower,upper,size\n0,0,2,2\n1,1,3,1\n")).ok());
+  EXPECT_TRUE(Receive().solution.ok());
+}
+
+TEST_F(ServerTest, ServesManyConnections) {
+  StartServer();
+  for (int connection_idx = 0; connection_idx < 100; ++connection_idx) {
+    absl::StatusOr<int> fd = ConnectToServer(socket_path_);
+    ASSERT_TRUE(fd.ok()) << fd.status();
+    close(fd_);
+    fd_ = *fd;
+    ASSERT_TRUE(WriteFrame(fd_, EncodeSolveRequest(connection_idx, kCsvFormat,
+        3, "id,lower,upper,size\n0,0,2,2\n1,1,3,1\n")).ok());
+    EXPECT_EQ(Receive().request_id, connection_idx);
+  }
+}
+
+TEST_F(ServerTest, RejectsBadSocketPath) {
+  EXPECT_EQ(Server::Create("", SolverParams(), 1).status().code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(ConnectToServer(::testing::TempDir() + "missing.sock")
+                .status().code(),
+            absl::StatusCode::kUnavailable);
+}
+
+}  // namespace
+}  // namespace minimalloc
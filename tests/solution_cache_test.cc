@@ -0,0 +1,142 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "../src/solution_cache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../src/minimalloc.h"
+#include "../src/solver.h"
+#include "../src/validator.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+
+namespace minimalloc {
+namespace {
+
+Problem CreateProblem() {
+  return {
+    .buffers = {
+        {.id = "a", .lifespan = {0, 2}, .size = 2},
+        {.id = "b", .lifespan = {1, 3}, .size = 1,
+         .gaps = {{.lifespan = {2, 3}, .window = {{0, 1}}}}},
+        {.id = "c", .lifespan = {0, 1}, .size = 1, .alignment = 1},
+    },
+    .capacity = 3
+  };
+}
+
+std::string CreateCacheDir(const std::string& name) {
+  const std::string dir = ::testing::TempDir() + name;
+  std::filesystem::remove_all(dir);
+  return dir;
+}
+
+TEST(SolutionCacheTest, KeyIgnoresIdsAndOrder) {
+  const Problem problem = CreateProblem();
+  const std::string key = SolutionCache::ComputeKey(problem, SolverParams());
+  EXPECT_EQ(key.size(), 32);
+  Problem reordered = problem;
+  std::swap(reordered.buffers[0], reordered.buffers[2]);
+  reordered.buffers[1].id = "renamed";
+  EXPECT_EQ(SolutionCache::ComputeKey(reordered, SolverParams()), key);
+  EXPECT_EQ(SolutionCache::ComputeKey(problem, {.timeout = absl::Seconds(1)}),
+            key);
+  EXPECT_NE(SolutionCache::ComputeKey(problem, {.check_dominance = false}),
+            key);
+  Problem resized = problem;
+  resized.buffers[1].size = 2;
+  EXPECT_NE(SolutionCache::ComputeKey(resized, SolverParams()), key);
+  resized = problem;
+  resized.capacity = 4;
+  EXPECT_NE(SolutionCache::ComputeKey(resized, SolverParams()), key);
+}
+
+TEST(SolutionCacheTest, StoresAndLooksUp) {
+  const SolutionCache cache(CreateCacheDir("cache_store"));
+  const Problem problem = CreateProblem();
+  EXPECT_EQ(cache.Lookup(problem, SolverParams()).status().code(),
+            absl::StatusCode::kNotFound);
+  const Solution solution = {.offsets = {0, 2, 2}};
+  ASSERT_TRUE(cache.Store(problem, SolverParams(), solution).ok());
+  EXPECT_EQ(*cache.Lookup(problem, SolverParams()), solution);
+  // The offsets follow the buffers, wherever they happen to be.
+  Problem reordered = problem;
+  std::swap(reordered.buffers[0], reordered.buffers[2]);
+  const Solution expected = {.offsets = {2, 2, 0}};
+  EXPECT_EQ(*cache.Lookup(reordered, SolverParams()), expected);
+}
+
+TEST(SolutionCacheTest, RejectsInvalidEntries) {
+  const std::string dir = CreateCacheDir("cache_invalid");
+  const SolutionCache cache(dir);
+  const Problem problem = CreateProblem();
+  ASSERT_TRUE(cache.Store(problem, SolverParams(), {.offsets = {0, 0, 0}}).ok());
+  EXPECT_EQ(cache.Lookup(problem, SolverParams()).status().code(),
+            absl::StatusCode::kNotFound);
+  std::ofstream(dir + "/" + SolutionCache::ComputeKey(problem, SolverParams()))
+      << "garbage";
+  EXPECT_EQ(cache.Lookup(problem, SolverParams()).status().code(),
+            absl::StatusCode::kNotFound);
+  EXPECT_EQ(cache.Store(problem, SolverParams(), {.offsets = {0}}).code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST(SolutionCacheTest, SolvesWithCache) {
+  const SolutionCache cache(CreateCacheDir("cache_solve"));
+  const Problem problem = CreateProblem();
+  const Solver solver;
+  SolveContext context;
+  const absl::StatusOr<Solution> solution =
+      SolveWithCache(solver, cache, problem, context);
+  ASSERT_TRUE(solution.ok());
+  EXPECT_GT(context.get_stats().nodes, 0);
+  SolveContext cached_context;
+  EXPECT_EQ(*SolveWithCache(solver, cache, problem, cached_context), *solution);
+  EXPECT_EQ(cached_context.get_stats().nodes, 0);
+}
+
+TEST(SolutionCacheTest, CachesPartitions) {
+  const SolutionCache cache(CreateCacheDir("cache_partitions"));
+  // Twenty buffers that form a single partition, then the same shifted in time.
+  Problem problem = {.capacity = 64};
+  for (int64_t buffer_idx = 0; buffer_idx < 20; ++buffer_idx) {
+    problem.buffers.push_back({.lifespan = {buffer_idx, buffer_idx + 4},
+                               .size = 1 + buffer_idx % 5});
+  }
+  Problem shifted = problem;
+  for (Buffer& buffer : shifted.buffers) {
+    buffer.lifespan = {buffer.lifespan.lower() + 100,
+                       buffer.lifespan.upper() + 100};
+  }
+  Solver solver(SolverParams(), &cache);
+  ASSERT_TRUE(solver.Solve(problem).ok());
+  EXPECT_EQ(solver.get_stats().reused_partitions, 0);
+  const absl::StatusOr<Solution> solution = solver.Solve(shifted);
+  ASSERT_TRUE(solution.ok());
+  EXPECT_EQ(Validate(shifted, *solution), kGood);
+  EXPECT_EQ(solver.get_stats().reused_partitions, 1);
+  EXPECT_EQ(solver.get_stats().nodes, 0);
+}
+
+}  // namespace
+}  // namespace minimalloc
@@ -16,13 +16,18 @@ limitations under the License.
 
 #include "../src/solver.h"
 
+#include <cstdint>
 #include <functional>
+#include <thread>
 #include <tuple>
 #include <vector>
 
+#include "../src/generator.h"
 #include "../src/minimalloc.h"
+#include "../src/validator.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/algorithm/container.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/time/time.h"
@@ -54,6 +59,9 @@ SolverParams getDisabledParams() {
     .dynamic_decomposition = false,
     .monotonic_floor = false,
     .hatless_pruning = false,
+    .deduplicate_partitions = false,
+    .break_symmetries = false,
+    .small_partition_search = false,
     .preordering_heuristics = {"TWA"},
   };
 }
@@ -64,7 +72,8 @@ class SolverTest
     : public ::testing::TestWithParam<std::tuple<
           CanonicalOnlyParam, SectionInferenceParam, DynamicOrderingParam,
           CheckDominanceParam, UnallocatedFloorParam, StaticPreorderingParam,
-          DynamicDecompositionParam, MonotonicFloorParam>> {
+          DynamicDecompositionParam, MonotonicFloorParam,
+          SmallPartitionSearchParam>> {
  protected:
   void test_feasible(const Problem& problem) {
     Solver solver(getParams());
@@ -92,6 +101,7 @@ class SolverTest
         .dynamic_decomposition = std::get<6>(GetParam()),
         .monotonic_floor = std::get<7>(GetParam()),
         .hatless_pruning = false,
+        .small_partition_search = std::get<8>(GetParam()),
     };
   }
 };
@@ -100,7 +110,8 @@ INSTANTIATE_TEST_SUITE_P(
     SolverTest, SolverTest,
     ::testing::Combine(::testing::Bool(), ::testing::Bool(), ::testing::Bool(),
                        ::testing::Bool(), ::testing::Bool(), ::testing::Bool(),
-                       ::testing::Bool(), ::testing::Bool()));
+                       ::testing::Bool(), ::testing::Bool(),
+                       ::testing::Bool()));
 
 TEST_P(SolverTest, InfeasibleBufferTooBig) {
   const Problem problem = {
@@ -297,9 +308,280 @@ TEST(SolverTest, CountsBacktracks) {
   Solver solver(getDisabledParams());
   EXPECT_EQ(solver.Solve(problem).status().code(), absl::StatusCode::kNotFound);
   EXPECT_EQ(solver.get_backtracks(), 3);
+  EXPECT_EQ(solver.get_stats().nodes, 3);
   // Now solve it again to see if it resets.
   EXPECT_EQ(solver.Solve(problem).status().code(), absl::StatusCode::kNotFound);
   EXPECT_EQ(solver.get_backtracks(), 3);
+  EXPECT_EQ(solver.get_stats().nodes, 3);
+}
+
+TEST(SolverTest, SolvesConcurrentlyWithContexts) {
+  const Problem problem = {
+    .buffers = {
+        {.lifespan = {0, 2}, .size = 2},
+        {.lifespan = {0, 2}, .size = 2},
+    },
+    .capacity = 3
+  };
+  const Solver solver(getDisabledParams());
+  std::vector<SolveContext> contexts(8);
+  std::vector<std::thread> threads;
+  for (SolveContext& context : contexts) {
+    threads.emplace_back([&solver, &problem, &context]() {
+      EXPECT_EQ(solver.Solve(problem, context).status().code(),
+                absl::StatusCode::kNotFound);
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  for (const SolveContext& context : contexts) {
+    EXPECT_EQ(context.get_stats().backtracks, 3);
+    EXPECT_EQ(context.get_stats().nodes, 3);
+  }
+}
+
+TEST(SolverTest, CancelsContext) {
+  const Problem problem = {
+    .buffers = {{.lifespan = {0, 2}, .size = 2}},
+    .capacity = 2
+  };
+  const Solver solver;
+  SolveContext context;
+  context.Cancel();
+  EXPECT_EQ(solver.Solve(problem, context).status().code(),
+            absl::StatusCode::kDeadlineExceeded);
+  context.Reset();
+  EXPECT_EQ(solver.Solve(problem, context).status().code(),
+            absl::StatusCode::kOk);
+}
+
+TEST(SolverTest, DeduplicatesPartitions) {
+  // The second partition is the first one shifted in time (in another order).
+  const Problem problem = {
+    .buffers = {
+        {.lifespan = {0, 2}, .size = 2},
+        {.lifespan = {1, 3}, .size = 1},
+        {.lifespan = {0, 1}, .size = 1, .gaps = {{.lifespan = {0, 1}}}},
+        {.lifespan = {11, 13}, .size = 1},
+        {.lifespan = {10, 12}, .size = 2},
+        {.lifespan = {10, 11}, .size = 1, .gaps = {{.lifespan = {10, 11}}}},
+    },
+    .capacity = 3
+  };
+  Solver solver;
+  const absl::StatusOr<Solution> solution = solver.Solve(problem);
+  ASSERT_TRUE(solution.ok());
+  EXPECT_EQ(Validate(problem, *solution), kGood);
+  EXPECT_EQ(solver.get_stats().reused_partitions, 1);
+  EXPECT_EQ(solution->offsets[4], solution->offsets[0]);
+  EXPECT_EQ(solution->offsets[3], solution->offsets[1]);
+  EXPECT_EQ(solution->offsets[5], solution->offsets[2]);
+  Solver disabled_solver({.deduplicate_partitions = false});
+  const absl::StatusOr<Solution> disabled_solution =
+      disabled_solver.Solve(problem);
+  ASSERT_TRUE(disabled_solution.ok());
+  EXPECT_EQ(Validate(problem, *disabled_solution), kGood);
+  EXPECT_EQ(disabled_solver.get_stats().reused_partitions, 0);
+  EXPECT_GT(disabled_solver.get_stats().nodes, solver.get_stats().nodes);
+}
+
+TEST(SolverTest, BreaksSymmetries) {
+  // Five identical buffers (and one other) that can't all fit.
+  Problem problem = {.capacity = 5};
+  for (int copy = 0; copy < 5; ++copy) {
+    problem.buffers.push_back({.lifespan = {0, 4}, .size = 1});
+  }
+  problem.buffers.push_back({.lifespan = {2, 6}, .size = 1});
+  Solver solver(getDisabledParams());
+  EXPECT_EQ(solver.Solve(problem).status().code(), absl::StatusCode::kNotFound);
+  SolverParams params = getDisabledParams();
+  params.break_symmetries = true;
+  Solver symmetric_solver(params);
+  EXPECT_EQ(symmetric_solver.Solve(problem).status().code(),
+            absl::StatusCode::kNotFound);
+  EXPECT_LT(symmetric_solver.get_backtracks() * 10, solver.get_backtracks());
+  // Removing one of the duplicates makes it feasible again.
+  problem.buffers.erase(problem.buffers.begin());
+  const absl::StatusOr<Solution> solution = symmetric_solver.Solve(problem);
+  ASSERT_TRUE(solution.ok());
+  EXPECT_EQ(Validate(problem, *solution), kGood);
+  EXPECT_TRUE(absl::c_is_sorted(
+      std::vector<Offset>(solution->offsets.begin(),
+                          solution->offsets.begin() + 4)));
+}
+
+TEST(SolverTest, NormalizesScale) {
+  const Problem problem = {
+    .buffers = {
+        {.lifespan = {0, 2}, .size = 64, .alignment = 32},
+        {.lifespan = {1, 3}, .size = 32, .alignment = 32},
+        {.lifespan = {0, 1}, .size = 32, .alignment = 64},
+        {.lifespan = {1, 2}, .size = 96, .alignment = 32,
+         .gaps = {{.lifespan = {1, 2}, .window = {{32, 64}}}}},
+    },
+    .capacity = 200
+  };
+  Solver solver;
+  const absl::StatusOr<Solution> solution = solver.Solve(problem);
+  ASSERT_TRUE(solution.ok());
+  EXPECT_EQ(Validate(problem, *solution), kGood);
+  Solver unscaled_solver({.normalize_scale = false});
+  EXPECT_EQ(*unscaled_solver.Solve(problem), *solution);
+}
+
+TEST(SolverTest, SolvesWideProblems) {
+  // These sizes share no common divisor, so the search must use 64 bits.
+  const int64_t size = int64_t{1} << 40;
+  const Problem problem = {
+    .buffers = {
+        {.lifespan = {0, 2}, .size = size + 1},
+        {.lifespan = {1, 3}, .size = size},
+        {.lifespan = {1, 2}, .size = size - 1},
+    },
+    .capacity = 3 * size
+  };
+  Solver solver;
+  const absl::StatusOr<Solution> solution = solver.Solve(problem);
+  ASSERT_TRUE(solution.ok());
+  EXPECT_EQ(Validate(problem, *solution), kGood);
+}
+
+TEST(SolverTest, PreordersWideProblemsLikeScaledDownOnes) {
+  // Scaling every size past 32 bits mustn't change the search, so long as the
+  // scaled problem is solved without being normalized back down.
+  const int64_t scale = int64_t{1} << 31;
+  for (uint64_t seed = 0; seed < 10; ++seed) {
+    const absl::StatusOr<Problem> problem = Generate(
+        {.num_buffers = 24, .max_length = 10, .max_size = 16,
+         .tightness = 0.9, .seed = seed});
+    ASSERT_TRUE(problem.ok());
+    Problem wide_problem = *problem;
+    wide_problem.capacity *= scale;
+    for (Buffer& buffer : wide_problem.buffers) buffer.size *= scale;
+    const SolverParams params = {.normalize_scale = false,
+                                 .preordering_heuristics = {"TWA"}};
+    Solver solver(params);
+    Solver wide_solver(params);
+    const absl::StatusOr<Solution> solution = solver.Solve(*problem);
+    const absl::StatusOr<Solution> wide_solution =
+        wide_solver.Solve(wide_problem);
+    ASSERT_EQ(solution.ok(), wide_solution.ok());
+    EXPECT_EQ(solver.get_stats().nodes, wide_solver.get_stats().nodes);
+    if (!solution.ok()) continue;
+    for (int idx = 0; idx < solution->offsets.size(); ++idx) {
+      EXPECT_EQ(solution->offsets[idx] * scale, wide_solution->offsets[idx]);
+    }
+  }
+}
+
+// Covers both the specialized search configurations (the defaults, and the
+// defaults less one param) and those resolved at runtime, with & without gaps.
+TEST(SolverTest, SolvesUnderEachConfiguration) {
+  std::vector<SolverParams> configurations = {SolverParams()};
+  for (bool SolverParams::* const member :
+       {&SolverParams::canonical_only, &SolverParams::section_inference,
+        &SolverParams::dynamic_ordering, &SolverParams::check_dominance,
+        &SolverParams::unallocated_floor, &SolverParams::dynamic_decomposition,
+        &SolverParams::monotonic_floor, &SolverParams::hatless_pruning,
+        &SolverParams::break_symmetries}) {
+    configurations.push_back(SolverParams());
+    configurations.back().*member = false;
+  }
+  configurations.push_back(
+      {.canonical_only = false, .check_dominance = false});
+  configurations.push_back(getDisabledParams());
+  for (const double gap_density : {0.0, 1.0}) {
+    const absl::StatusOr<Problem> problem = Generate(
+        {.num_buffers = 12, .max_length = 10, .gap_density = gap_density,
+         .tightness = 0.9});
+    ASSERT_TRUE(problem.ok());
+    for (const SolverParams& params : configurations) {
+      Solver solver(params);
+      const absl::StatusOr<Solution> solution = solver.Solve(*problem);
+      ASSERT_TRUE(solution.ok());
+      EXPECT_EQ(Validate(*problem, *solution), kGood);
+    }
+  }
+}
+
+TEST(SolverTest, SmallPartitionSearchFindsSameSolutions) {
+  for (uint64_t seed = 0; seed < 20; ++seed) {
+    const absl::StatusOr<Problem> problem = Generate(
+        {.num_buffers = 24, .num_partitions = 3, .max_length = 10,
+         .alignments = {{.alignment = 1}, {.alignment = 4}},
+         .gap_density = seed % 2 ? 1.0 : 0.0, .tightness = 0.9,
+         .seed = seed});
+    ASSERT_TRUE(problem.ok());
+    Solver solver;
+    Solver main_solver({.small_partition_search = false});
+    const absl::StatusOr<Solution> solution = solver.Solve(*problem);
+    const absl::StatusOr<Solution> main_solution = main_solver.Solve(*problem);
+    ASSERT_EQ(solution.ok(), main_solution.ok());
+    if (solution.ok()) {
+      EXPECT_EQ(solution->offsets, main_solution->offsets);
+    }
+  }
+}
+
+TEST(SolverTest, SmallPartitionSearchHonorsFixedOffsets) {
+  for (uint64_t seed = 0; seed < 20; ++seed) {
+    absl::StatusOr<Problem> problem = Generate(
+        {.num_buffers = 24, .num_partitions = 3, .max_length = 10,
+         .tightness = 0.9, .seed = seed});
+    ASSERT_TRUE(problem.ok());
+    Solver main_solver({.small_partition_search = false});
+    const absl::StatusOr<Solution> pinned = main_solver.Solve(*problem);
+    if (!pinned.ok()) continue;
+    // Pin every third buffer to where it was first placed.
+    for (int buffer_idx = 0; buffer_idx < problem->buffers.size();
+         buffer_idx += 3) {
+      problem->buffers[buffer_idx].offset = pinned->offsets[buffer_idx];
+    }
+    Solver solver;
+    const absl::StatusOr<Solution> solution = solver.Solve(*problem);
+    const absl::StatusOr<Solution> main_solution = main_solver.Solve(*problem);
+    ASSERT_EQ(solution.ok(), main_solution.ok());
+    if (solution.ok()) {
+      EXPECT_EQ(solution->offsets, main_solution->offsets);
+    }
+  }
+}
+
+TEST(SolverTest, SmallPartitionSearchNeedsDecomposition) {
+  // This partition is only solved once decomposition splits it at time 15.
+  const Problem problem = {
+    .buffers = {
+        {.lifespan = {11, 15}, .size = 2, .alignment = 3},
+        {.lifespan = {14, 22}, .size = 2, .alignment = 2,
+         .gaps = {{.lifespan = {15, 20}, .window = {{0, 0}}}}},
+        {.lifespan = {12, 20}, .size = 3, .gaps = {{.lifespan = {13, 16}}}},
+        {.lifespan = {12, 20}, .size = 4, .alignment = 2},
+    },
+    .capacity = 10
+  };
+  Solver solver;
+  const absl::StatusOr<Solution> solution = solver.Solve(problem);
+  ASSERT_TRUE(solution.ok());
+  EXPECT_EQ(Validate(problem, *solution), kGood);
+}
+
+TEST(SolverTest, DenseOverlapsFindSameSolutions) {
+  for (uint64_t seed = 0; seed < 10; ++seed) {
+    const absl::StatusOr<Problem> problem = Generate(
+        {.num_buffers = 96, .horizon = 48, .max_length = 32,
+         .alignments = {{.alignment = 1}, {.alignment = 4}},
+         .gap_density = seed % 2 ? 1.0 : 0.0, .tightness = 0.8,
+         .seed = seed});
+    ASSERT_TRUE(problem.ok());
+    Solver solver({.dense_overlaps = true});
+    Solver main_solver;
+    const absl::StatusOr<Solution> solution = solver.Solve(*problem);
+    const absl::StatusOr<Solution> main_solution = main_solver.Solve(*problem);
+    ASSERT_EQ(solution.ok(), main_solution.ok());
+    if (solution.ok()) {
+      EXPECT_EQ(solution->offsets, main_solution->offsets);
+    }
+    EXPECT_EQ(solver.get_stats().nodes, main_solver.get_stats().nodes);
+  }
 }
 
 using ReducesBacktracksTest =
@@ -16,6 +16,8 @@ limitations under the License.
 
 #include "../src/sweeper.h"
 
+#include <cstdint>
+#include <random>
 #include <vector>
 
 #include "../src/minimalloc.h"
@@ -175,6 +177,20 @@ TEST(CalculateCutsTest, WithOverlap) {
   EXPECT_EQ(sweep_result.CalculateCuts(), std::vector<CutCount>({0, 1}));
 }
 
+TEST(CalculateTotalsTest, WithOverlap) {
+  const SweepResult sweep_result = {
+      .sections = {{0}, {1, 2}, {2}},
+      .buffer_data = {
+          {.section_spans = {{.section_range = {0, 1}, .window = {0, 2}}}},
+          {.section_spans = {{.section_range = {1, 2}, .window = {0, 1}}},
+           .overlaps = {{2, 1}}},
+          {.section_spans = {{.section_range = {1, 3}, .window = {0, 1}}},
+           .overlaps = {{1, 1}}},
+      },
+  };
+  EXPECT_EQ(sweep_result.CalculateTotals(), std::vector<int64_t>({2, 2, 1}));
+}
+
 //////// TwoBuffersEndAtSameTime ////////
 //                                     //
 //            t=0    t=1    t=2    t=3 //
@@ -508,6 +524,26 @@ TEST(CalculateCutsTest, WithGaps) {
   EXPECT_EQ(sweep_result.CalculateCuts(), std::vector<CutCount>({2, 3, 2}));
 }
 
+TEST(CalculateTotalsTest, WithGaps) {
+  const SweepResult sweep_result = {
+      .sections = {{0, 2}, {1}, {0}, {1, 2}},
+      .partitions = {{.buffer_idxs = {0, 2, 1}, .section_range = {0, 4}}},
+      .buffer_data = {
+          {.section_spans = {{.section_range = {0, 1}, .window = {0, 1}},
+                             {.section_range = {2, 3}, .window = {0, 1}}},
+           .overlaps = {{2, 1}}},
+          {.section_spans = {{.section_range = {1, 2}, .window = {0, 1}},
+                             {.section_range = {3, 4}, .window = {0, 1}}},
+           .overlaps = {{2, 1}}},
+          {.section_spans = {{.section_range = {0, 1}, .window = {0, 1}},
+                             {.section_range = {3, 4}, .window = {0, 1}}},
+           .overlaps = {{0, 1}, {1, 1}}},
+      },
+  };
+  EXPECT_EQ(sweep_result.CalculateTotals(),
+            std::vector<int64_t>({2, 1, 1, 2}));
+}
+
 //////////////////// Tetris ////////////////////
 //                                            //
 //            t=4    t=5    t=6    t=7    t=8 //
@@ -670,5 +706,93 @@ TEST(CalculateCutsTest, MixedGaps) {
   EXPECT_EQ(sweep_result.CalculateCuts(), std::vector<CutCount>({1, 1}));
 }
 
+// Checks that the incremental result matches a sweep performed from scratch.
+void ExpectMatchesSweep(const IncrementalSweeper& sweeper) {
+  const SweepResult sweep_result = Sweep(sweeper.problem());
+  EXPECT_EQ(sweeper.sweep_result(), sweep_result);
+  if (!sweep_result.sections.empty()) {
+    EXPECT_EQ(sweeper.cuts(), sweep_result.CalculateCuts());
+  }
+}
+
+TEST(IncrementalSweeperTest, Empty) {
+  IncrementalSweeper sweeper(Problem{});
+  EXPECT_EQ(sweeper.sweep_result(), SweepResult());
+  EXPECT_TRUE(sweeper.cuts().empty());
+}
+
+TEST(IncrementalSweeperTest, AddBufferMergesPartitions) {
+  IncrementalSweeper sweeper({
+      .buffers = {
+          {.lifespan = {0, 1}, .size = 2},
+          {.lifespan = {1, 2}, .size = 1},
+          {.lifespan = {2, 3}, .size = 1},
+      }
+  });
+  ExpectMatchesSweep(sweeper);
+  EXPECT_EQ(sweeper.AddBuffer({.lifespan = {0, 2}, .size = 1}), 3);
+  ExpectMatchesSweep(sweeper);
+  EXPECT_EQ(sweeper.sweep_result().partitions.size(), 2);
+  EXPECT_EQ(sweeper.AddBuffer({.lifespan = {5, 6}, .size = 1}), 4);
+  ExpectMatchesSweep(sweeper);
+}
+
+TEST(IncrementalSweeperTest, RemoveBufferSplitsPartitions) {
+  IncrementalSweeper sweeper({
+      .buffers = {
+          {.lifespan = {0, 5}, .size = 1},
+          {.lifespan = {1, 2}, .size = 1},
+          {.lifespan = {3, 4}, .size = 1},
+          {.lifespan = {6, 8}, .size = 1},
+      }
+  });
+  EXPECT_EQ(sweeper.sweep_result().partitions.size(), 2);
+  sweeper.RemoveBuffer(0);
+  ExpectMatchesSweep(sweeper);
+  EXPECT_EQ(sweeper.problem().buffers[0].lifespan, Lifespan({6, 8}));
+  EXPECT_EQ(sweeper.sweep_result().partitions.size(), 3);
+  sweeper.RemoveBuffer(2);
+  ExpectMatchesSweep(sweeper);
+}
+
+TEST(IncrementalSweeperTest, UpdateLifespanWithGaps) {
+  IncrementalSweeper sweeper({
+      .buffers = {
+          {.lifespan = {0, 10}, .size = 2, .gaps = {{.lifespan = {1, 9}}}},
+          {.lifespan = {5, 15}, .size = 2,
+           .gaps = {{.lifespan = {6, 14}, .window = {{0, 1}}}}},
+          {.lifespan = {20, 25}, .size = 1},
+      }
+  });
+  sweeper.UpdateLifespan(2, {14, 25});
+  ExpectMatchesSweep(sweeper);
+  sweeper.UpdateLifespan(2, {30, 40});
+  ExpectMatchesSweep(sweeper);
+}
+
+TEST(IncrementalSweeperTest, RandomEdits) {
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int64_t> time_dist(0, 100);
+  std::uniform_int_distribution<int64_t> length_dist(1, 10);
+  std::uniform_int_distribution<int> action_dist(0, 2);
+  const auto random_lifespan = [&]() -> Lifespan {
+    const TimeValue lower = time_dist(gen);
+    return {lower, lower + length_dist(gen)};
+  };
+  IncrementalSweeper sweeper(Problem{});
+  for (int step = 0; step < 500; ++step) {
+    const auto num_buffers = sweeper.problem().buffers.size();
+    const int action = num_buffers < 10 ? 0 : action_dist(gen);
+    if (action == 0) {
+      sweeper.AddBuffer({.lifespan = random_lifespan(), .size = 1});
+    } else {
+      std::uniform_int_distribution<BufferIdx> idx_dist(0, num_buffers - 1);
+      if (action == 1) sweeper.RemoveBuffer(idx_dist(gen));
+      if (action == 2) sweeper.UpdateLifespan(idx_dist(gen), random_lifespan());
+    }
+    ExpectMatchesSweep(sweeper);
+  }
+}
+
 }  // namespace
 }  // namespace minimalloc
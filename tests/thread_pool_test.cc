@@ -0,0 +1,59 @@
+/*
+Copyright 2023 Google LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    https://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "../src/thread_pool.h"
+
+#include <atomic>
+
+#include "gtest/gtest.h"
+#include "absl/synchronization/blocking_counter.h"
+
+namespace minimalloc {
+namespace {
+
+TEST(ThreadPoolTest, RunsAllTasks) {
+  std::atomic<int> sum = 0;
+  {
+    ThreadPool thread_pool(4);
+    EXPECT_EQ(thread_pool.num_threads(), 4);
+    for (int task_idx = 1; task_idx <= 100; ++task_idx) {
+      thread_pool.Schedule([&sum, task_idx]() { sum += task_idx; });
+    }
+  }  // The destructor waits for all tasks to finish.
+  EXPECT_EQ(sum, 5050);
+}
+
+TEST(ThreadPoolTest, WaitsWithBlockingCounter) {
+  ThreadPool thread_pool(2);
+  absl::BlockingCounter counter(10);
+  std::atomic<int> count = 0;
+  for (int task_idx = 0; task_idx < 10; ++task_idx) {
+    thread_pool.Schedule([&]() {
+      ++count;
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  EXPECT_EQ(count, 10);
+}
+
+TEST(ThreadPoolTest, AtLeastOneThread) {
+  ThreadPool thread_pool(0);
+  EXPECT_EQ(thread_pool.num_threads(), 1);
+}
+
+}  // namespace
+}  // namespace minimalloc
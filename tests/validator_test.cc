@@ -16,7 +16,12 @@ limitations under the License.
 
 #include "../src/validator.h"
 
+#include <optional>
+#include <random>
+#include <vector>
+
 #include "../src/minimalloc.h"
+#include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
 namespace minimalloc {
@@ -206,5 +211,237 @@ TEST(ValidatorTest, InvalidatesGapOverlap) {
   EXPECT_EQ(Validate(problem, solution), kBadOverlap);
 }
 
+TEST(ValidatorTest, InvalidatesWindowOverlap) {
+  const Problem problem = {
+    .buffers = {
+        {.lifespan = {0, 10}, .size = 4, .gaps = {{.lifespan = {2, 8},
+                                                   .window = {{2, 3}}}}},
+        {.lifespan = {4, 6}, .size = 1},
+     },
+    .capacity = 4
+  };
+  // the second buffer is clear of the window but not of the full buffer
+  EXPECT_EQ(Validate(problem, {.offsets = {0, 3}}), kGood);
+  EXPECT_EQ(Validate(problem, {.offsets = {0, 2}}), kBadOverlap);
+}
+
+TEST(ValidatorTest, MatchesPairwiseCheck) {
+  std::mt19937 gen(0);
+  for (int trial = 0; trial < 100; ++trial) {
+    Problem problem = {.capacity = 16};
+    Solution solution;
+    for (int buffer_idx = 0; buffer_idx < 20; ++buffer_idx) {
+      const TimeValue lower = gen() % 20;
+      const int64_t size = gen() % 4 + 1;
+      problem.buffers.push_back(
+          {.lifespan = {lower, lower + 1 + static_cast<TimeValue>(gen() % 5)},
+           .size = size});
+      solution.offsets.push_back(gen() % (problem.capacity - size + 1));
+    }
+    bool overlap = false;
+    for (int i = 0; i < problem.buffers.size(); ++i) {
+      const Buffer& buffer_i = problem.buffers[i];
+      for (int j = i + 1; j < problem.buffers.size(); ++j) {
+        const Buffer& buffer_j = problem.buffers[j];
+        if (!buffer_i.effective_size(buffer_j)) continue;
+        if (solution.offsets[i] + buffer_i.size <= solution.offsets[j]) {
+          continue;
+        }
+        if (solution.offsets[j] + buffer_j.size <= solution.offsets[i]) {
+          continue;
+        }
+        overlap = true;
+      }
+    }
+    EXPECT_EQ(Validate(problem, solution), overlap ? kBadOverlap : kGood);
+  }
+}
+
+TEST(ValidateAllTest, ReportsGoodSolution) {
+  const Problem problem = {
+    .buffers = {
+        {.lifespan = {0, 10}, .size = 2, .gaps = {{.lifespan = {1, 9}}}},
+        {.lifespan = {5, 15}, .size = 2, .gaps = {{.lifespan = {6, 14}}}},
+     },
+    .capacity = 2
+  };
+  const ValidationReport report = ValidateAll(problem, {.offsets = {0, 0}});
+  EXPECT_EQ(report.result, kGood);
+  EXPECT_TRUE(report.violations.empty());
+}
+
+TEST(ValidateAllTest, ReportsBadSolution) {
+  const Problem problem = {.buffers = {{.lifespan = {0, 1}, .size = 2}}};
+  EXPECT_EQ(ValidateAll(problem, {}).result, kBadSolution);
+}
+
+TEST(ValidateAllTest, ReportsEveryViolation) {
+  const Problem problem = {
+    .buffers = {
+        {.lifespan = {0, 10}, .size = 2},
+        {.lifespan = {5, 15}, .size = 2, .gaps = {{.lifespan = {7, 12}}}},
+        {.lifespan = {0, 20}, .size = 1, .alignment = 2},
+        {.lifespan = {0, 20}, .size = 1, .offset = 3},
+     },
+    .capacity = 4
+  };
+  const Solution solution = {.offsets = {0, 1, 1, 4}};
+  const ValidationReport report = ValidateAll(problem, solution);
+  EXPECT_EQ(report.result, Validate(problem, solution));
+  EXPECT_THAT(report.violations, testing::ElementsAre(
+      Violation{.kind = kBadOverlap, .buffer_idx = 0, .other_idx = 1,
+                .lifespan = Lifespan{5, 7}},
+      Violation{.kind = kBadOverlap, .buffer_idx = 0, .other_idx = 2,
+                .lifespan = Lifespan{0, 10}},
+      Violation{.kind = kBadOverlap, .buffer_idx = 1, .other_idx = 2,
+                .lifespan = Lifespan{5, 7}},
+      Violation{.kind = kBadOverlap, .buffer_idx = 1, .other_idx = 2,
+                .lifespan = Lifespan{12, 15}},
+      Violation{.kind = kBadAlignment, .buffer_idx = 2},
+      Violation{.kind = kBadFixed, .buffer_idx = 3},
+      Violation{.kind = kBadOffset, .buffer_idx = 3}));
+}
+
+// Returns the memory occupied by a buffer at a given time (if any).
+std::optional<Window> Occupied(const Buffer& buffer, TimeValue time) {
+  if (time < buffer.lifespan.lower()) return std::nullopt;
+  if (time >= buffer.lifespan.upper()) return std::nullopt;
+  for (const Gap& gap : buffer.gaps) {
+    if (time < gap.lifespan.lower() || time >= gap.lifespan.upper()) continue;
+    return gap.window;
+  }
+  return Window{0, buffer.size};
+}
+
+TEST(ValidateAllTest, MatchesBruteForce) {
+  std::mt19937 gen(0);
+  for (int trial = 0; trial < 100; ++trial) {
+    Problem problem = {.capacity = 16};
+    Solution solution;
+    for (int buffer_idx = 0; buffer_idx < 30; ++buffer_idx) {
+      const TimeValue lower = gen() % 30;
+      const TimeValue upper = lower + 1 + gen() % 8;
+      const int64_t size = gen() % 4 + 1;
+      Buffer buffer = {.lifespan = {lower, upper}, .size = size};
+      if (gen() % 2) {
+        const TimeValue gap_lower = lower + gen() % (upper - lower);
+        Gap gap = {.lifespan = {
+            gap_lower, gap_lower + 1 + static_cast<TimeValue>(gen() % 3)}};
+        if (gen() % 2) gap.window = {{0, 1 + (int64_t)(gen() % size)}};
+        buffer.gaps.push_back(gap);
+      }
+      problem.buffers.push_back(buffer);
+      solution.offsets.push_back(gen() % (problem.capacity - size + 1));
+    }
+    std::vector<Violation> expected;
+    for (BufferIdx i = 0; i < problem.buffers.size(); ++i) {
+      for (BufferIdx j = i + 1; j < problem.buffers.size(); ++j) {
+        std::optional<TimeValue> start;
+        for (TimeValue time = 0; time <= 50; ++time) {
+          const auto window_i = Occupied(problem.buffers[i], time);
+          const auto window_j = Occupied(problem.buffers[j], time);
+          const bool overlap = window_i && window_j &&
+              solution.offsets[i] + window_i->lower() <
+                  solution.offsets[j] + window_j->upper() &&
+              solution.offsets[j] + window_j->lower() <
+                  solution.offsets[i] + window_i->upper();
+          if (overlap && !start) start = time;
+          if (!overlap && start) {
+            expected.push_back({.kind = kBadOverlap, .buffer_idx = i,
+                                .other_idx = j,
+                                .lifespan = Lifespan{*start, time}});
+            start.reset();
+          }
+        }
+      }
+    }
+    for (int num_threads : {1, 4}) {
+      const ValidationReport report =
+          ValidateAll(problem, solution, num_threads);
+      EXPECT_EQ(report.violations, expected);
+      EXPECT_EQ(report.result, Validate(problem, solution));
+    }
+  }
+}
+
+TEST(IncrementalValidatorTest, ChecksChanges) {
+  const Problem problem = {
+    .buffers = {
+        {.lifespan = {0, 10}, .size = 2, .gaps = {{.lifespan = {2, 8},
+                                                   .window = {{0, 1}}}}},
+        {.lifespan = {4, 6}, .size = 1},
+        {.lifespan = {6, 12}, .size = 2, .alignment = 2},
+        {.lifespan = {0, 12}, .size = 1, .offset = 3},
+     },
+    .capacity = 4
+  };
+  const IncrementalValidator validator(problem, {.offsets = {0, 1, 2, 3}});
+  EXPECT_EQ(validator.Check({}), kGood);
+  EXPECT_EQ(validator.Check({{.buffer_idx = 1, .offset = 2}}), kGood);
+  EXPECT_EQ(validator.Check({{.buffer_idx = 1, .offset = 0}}), kBadOverlap);
+  EXPECT_EQ(validator.Check({{.buffer_idx = 2, .offset = 1}}), kBadAlignment);
+  EXPECT_EQ(validator.Check({{.buffer_idx = 2, .offset = 4}}), kBadOffset);
+  EXPECT_EQ(validator.Check({{.buffer_idx = 3, .offset = 2}}), kBadFixed);
+  EXPECT_EQ(validator.Check({{.buffer_idx = 4, .offset = 0}}), kBadSolution);
+  // the second buffer moves out of the way of the third
+  EXPECT_EQ(validator.Check({{.buffer_idx = 2, .offset = 0}}), kBadOverlap);
+  EXPECT_EQ(validator.Check({{.buffer_idx = 2, .offset = 0},
+                             {.buffer_idx = 0, .offset = 2},
+                             {.buffer_idx = 0, .offset = 0}}), kBadOverlap);
+}
+
+TEST(IncrementalValidatorTest, AppliesOnlyGoodChanges) {
+  const Problem problem = {
+    .buffers = {
+        {.lifespan = {0, 2}, .size = 2},
+        {.lifespan = {1, 3}, .size = 2},
+     },
+    .capacity = 4
+  };
+  IncrementalValidator validator(problem, {.offsets = {0, 2}});
+  EXPECT_EQ(validator.Apply({{.buffer_idx = 0, .offset = 1}}), kBadOverlap);
+  EXPECT_EQ(validator.solution().offsets, std::vector<Offset>({0, 2}));
+  EXPECT_EQ(validator.Apply({{.buffer_idx = 0, .offset = 2},
+                             {.buffer_idx = 1, .offset = 0}}), kGood);
+  EXPECT_EQ(validator.solution().offsets, std::vector<Offset>({2, 0}));
+}
+
+TEST(IncrementalValidatorTest, MatchesValidate) {
+  std::mt19937 gen(0);
+  Problem problem;
+  Solution solution;
+  for (int buffer_idx = 0; buffer_idx < 50; ++buffer_idx) {
+    const TimeValue lower = gen() % 50;
+    const TimeValue upper = lower + 1 + gen() % 10;
+    Buffer buffer = {.lifespan = {lower, upper},
+                     .size = 1 + static_cast<int64_t>(gen() % 4)};
+    if (gen() % 2) {
+      const TimeValue gap_lower = lower + gen() % (upper - lower);
+      buffer.gaps.push_back(
+          {.lifespan = {gap_lower,
+                        gap_lower + 1 + static_cast<TimeValue>(gen() % 3)}});
+    }
+    solution.offsets.push_back(problem.capacity);
+    problem.capacity += buffer.size;
+    problem.buffers.push_back(buffer);
+  }
+  IncrementalValidator validator(problem, solution);
+  for (int trial = 0; trial < 1000; ++trial) {
+    std::vector<OffsetChange> changes;
+    Solution expected = validator.solution();
+    for (int change_idx = gen() % 3; change_idx >= 0; --change_idx) {
+      const BufferIdx buffer_idx = gen() % problem.buffers.size();
+      const Offset offset = gen() % (problem.capacity - 3);
+      changes.push_back({.buffer_idx = buffer_idx, .offset = offset});
+      expected.offsets[buffer_idx] = offset;
+    }
+    const ValidationResult result = Validate(problem, expected);
+    EXPECT_EQ(validator.Apply(changes), result);
+    if (result == kGood) {
+      EXPECT_EQ(validator.solution(), expected);
+    }
+  }
+}
+
 }  // namespace
 }  // namespace minimalloc